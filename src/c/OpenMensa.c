@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include "platform_profile.h"  // PROFILE_* capacities and toggles, generated per platform by wscript.
 
 #ifndef IMAGE_VEGAN
   #define IMAGE_VEGAN RESOURCE_ID_IMAGE_VEGAN
@@ -13,17 +14,350 @@
   #define IMAGE_POT RESOURCE_ID_IMAGE_POT
 #endif
 
+// Bump-pointer arena: strings for one dataset are appended and released together by a reset.
+typedef struct {
+  const char *name;
+  char *base;
+  size_t capacity;
+  size_t used;
+  size_t peak;
+} Arena;
+
+#define DAY_ARENA_SIZE PROFILE_DAY_ARENA_SIZE
+#define MEAL_ARENA_SIZE PROFILE_MEAL_ARENA_SIZE
+#define DETAIL_ARENA_SIZE PROFILE_DETAIL_ARENA_SIZE
+
+static char s_day_arena_buffer[DAY_ARENA_SIZE];
+static char s_meal_arena_buffer[MEAL_ARENA_SIZE];
+static char s_detail_arena_buffer[DETAIL_ARENA_SIZE];
+static Arena s_day_arena = { "days", s_day_arena_buffer, DAY_ARENA_SIZE, 0, 0 };
+static Arena s_meal_arena = { "meals", s_meal_arena_buffer, MEAL_ARENA_SIZE, 0, 0 };
+static Arena s_detail_arena = { "detail", s_detail_arena_buffer, DETAIL_ARENA_SIZE, 0, 0 };
+
 #define MAX_MENU_ITEMS 10
 static int s_menu_item_count = 0;
-static char *s_menu_titles[MAX_MENU_ITEMS];
+static uint16_t s_menu_days[MAX_MENU_ITEMS];  // Days since 1970-01-01.
+static char *s_menu_titles[MAX_MENU_ITEMS];   // Date and weekday labels formatted on the watch (in s_day_arena).
 static char *s_menu_subtitles[MAX_MENU_ITEMS];
 
-#define MAX_MEALS 20
+// Day list sent as DAY_DATA (see encodeDays in index.js): [version:1][count:1] then [day:2 LE] per day.
+#define DAY_DATA_VERSION 1
+#define DAY_NONE 0
+
+#define MAX_MEALS PROFILE_MAX_MEALS  // Meals held at once; longer lists are paged.
+// Long lists are paged: s_meal_total meals exist, of which the arrays below hold the
+// s_meal_count meals starting at list index s_meals_first. Sections use list indices.
+#define MEALS_PAGE_SIZE 10      // Meals per page, must match MEALS_PAGE_SIZE in index.js.
+#define MEALS_PREFETCH_ROWS 3   // Request the next page this many rows before the loaded end.
+static int s_meal_total = 0;
+static int s_meals_first = 0;
+#define MEALS_PAGE_TIMEOUT_MS 5000
+static int s_page_pending = -1; // First meal of the page requested from the phone, -1 if none.
+static bool s_page_request_pending = false;  // A page request found the outbox busy.
+static AppTimer *s_page_timer = NULL;
 static int s_meal_count = 0;
 static int s_meal_ids[MAX_MEALS];      // Internal IDs.
-static char *s_meal_titles[MAX_MEALS]; // Meal names.
-static char *s_meal_subtitles[MAX_MEALS]; // Prices as strings.
-static GBitmap* s_meal_bitmaps[MAX_MEALS] = {NULL};
+static char *s_meal_titles[MAX_MEALS]; // Meal names (in s_meal_arena).
+static char *s_meal_subtitles[MAX_MEALS]; // Prices as strings (in s_meal_arena).
+static GBitmap* s_meal_bitmaps[MAX_MEALS] = {NULL}; // Shared handles from the icon cache.
+static uint16_t s_meal_cents[MAX_MEALS];  // Prices as sent, kept to re-encode the list for the cache.
+static uint32_t s_meals_rev = 0;  // Revision of the loaded list as assigned by the phone; 0 if unknown.
+
+// Meal attribute flags derived on the phone (see diet.js).
+#define MEAL_FLAG_VEGAN      0x01
+#define MEAL_FLAG_VEGETARIAN 0x02
+#define MEAL_FLAG_FISH       0x04
+#define MEAL_FLAG_PORK       0x08
+#define MEAL_FLAG_BEEF       0x10
+#define MEAL_FLAG_POULTRY    0x20
+#define MEAL_FLAG_ALCOHOL    0x40
+static uint8_t s_meal_flags[MAX_MEALS];
+static bool s_meal_flags_valid = false;  // False for payloads without flags.
+static bool s_meal_names_cut = false;    // Some loaded names were cut under memory pressure.
+
+// One meals menu section per canteen. Section i holds the meals
+// s_section_first[i] .. s_section_first[i + 1] - 1 of the flat meal arrays.
+#define MAX_SECTIONS 4
+static int s_section_count = 0;
+static int s_section_first[MAX_SECTIONS + 1];
+static char *s_section_names[MAX_SECTIONS];  // Canteen names (in s_meal_arena), NULL when unnamed.
+
+// Diet icons are decoded once and shared by every meal row. New icons only need an
+// IconType and an entry in s_icon_resources.
+typedef enum {
+  ICON_POT,
+  ICON_VEGAN,
+  ICON_VEGETARIAN,
+  ICON_COUNT
+} IconType;
+
+static const uint32_t s_icon_resources[ICON_COUNT] = {
+  [ICON_POT] = IMAGE_POT,
+  [ICON_VEGAN] = IMAGE_VEGAN,
+  [ICON_VEGETARIAN] = IMAGE_VEGETARIAN,
+};
+
+typedef struct {
+  GBitmap *bitmap;
+  uint16_t refs;
+} IconCacheEntry;
+
+static IconCacheEntry s_icon_cache[ICON_COUNT];
+
+// Icon for the first matching flag; meals matching none get ICON_POT.
+static const struct {
+  uint8_t flag;
+  IconType icon;
+} s_flag_icons[] = {
+  { MEAL_FLAG_VEGAN, ICON_VEGAN },
+  { MEAL_FLAG_VEGETARIAN, ICON_VEGETARIAN },
+};
+
+// Row layout of the meals menu. A title is measured for both text columns, beside the icon
+// and at full width, so rows keep the right height when the governor drops or restores the
+// icons. Rows are tagged with the layout generation they were measured in; a new meal list
+// or menu width starts a new generation and rows are measured again when next asked for.
+#define MEAL_ICON_SIZE 30
+#define MEAL_ICON_OFFSET 5
+#define MEAL_ROW_PADDING 2
+#define MEAL_TITLE_MAX_LINES 2
+typedef enum {
+  MEAL_COLUMN_FULL_WIDTH,
+  MEAL_COLUMN_BESIDE_ICON,
+  MEAL_COLUMN_COUNT
+} MealColumn;
+
+typedef struct {
+  int16_t title_height[MEAL_COLUMN_COUNT];
+  uint16_t generation;
+} MealRowLayout;
+
+static GFont s_meal_title_font = NULL;
+static GFont s_meal_price_font = NULL;
+static int16_t s_meal_title_line_height = 0;
+static int16_t s_meal_price_line_height = 0;
+static GRect s_meal_title_columns[MEAL_COLUMN_COUNT];  // Title rect per column; the height is per row.
+static uint16_t s_meals_layout_generation = 1;
+static MealRowLayout s_meal_rows[MAX_MEALS];
+#define ICON_CACHE_MIN_FREE_HEAP PROFILE_ICON_CACHE_MIN_FREE_HEAP  // Unused icons are dropped below this much free heap.
+
+// Memory-pressure governor: before taking in a payload the free heap is compared against the
+// profile thresholds and the app steps through these levels, each including the ones before.
+typedef enum {
+  MEM_LEVEL_NORMAL,
+  MEM_LEVEL_NO_ICONS,     // Meal rows are drawn without icons.
+  MEM_LEVEL_SHORT_NAMES,  // New meal names are cut to MEM_SHORT_NAME_BYTES; pushed details are dropped.
+  MEM_LEVEL_FEW_ROWS,     // Half the meal window and half-sized pages.
+} MemLevel;
+#define MEM_SHORT_NAME_BYTES 32
+#define MEM_HYSTERESIS 512  // Extra free heap needed to leave a level again.
+static const size_t s_mem_thresholds[] = {
+  0, PROFILE_LOW_HEAP_ICONS, PROFILE_LOW_HEAP_NAMES, PROFILE_LOW_HEAP_ROWS
+};
+static MemLevel s_mem_level = MEM_LEVEL_NORMAL;
+static bool s_mem_report_pending = false;
+
+// Binary meal list sent as MEALS_DATA (see encodeMeals in index.js):
+//   [version:1][count:1] then per meal [id:4 LE][price cents:2 LE][flags:1][name length:1][name bytes]
+// Version 1 has no flags byte; its meals are still classified by name on the watch.
+#define MEALS_DATA_VERSION 3
+#define MEALS_DATA_VERSION_NO_SECTIONS 2
+#define MEALS_DATA_VERSION_NO_FLAGS 1
+#define MEALS_DATA_HEADER_SIZE 2
+#define MEALS_DATA_NO_PRICE 0xFFFF
+
+// Changes against the list of revision base, sent as XFER_KIND_MEALS_DELTA (see encodeMealsDelta
+// in index.js): [version][base revision:4 LE][op count] then per op
+//   remove: [DELTA_OP_REMOVE][id:4]
+//   add:    [DELTA_OP_ADD][section][row][meal record as in MEALS_DATA v2/v3]
+//   change: [DELTA_OP_CHANGE][id:4][fields] then [cents:2] / [flags:1] / [name length][name]
+#define MEALS_DELTA_VERSION 1
+#define MEALS_DELTA_HEADER_SIZE 6
+#define DELTA_OP_REMOVE 1
+#define DELTA_OP_ADD 2
+#define DELTA_OP_CHANGE 3
+#define DELTA_FIELD_PRICE 0x01
+#define DELTA_FIELD_FLAGS 0x02
+#define DELTA_FIELD_NAME 0x04
+
+// Persistent cache of the last day list and the meals of the last few dates, shown as stale
+// at launch until the phone sends fresh data.
+//
+// Storage budget: an app has 4 KB of persistent storage in values of at most
+// PERSIST_DATA_MAX_LENGTH (256) bytes. With the largest profile (MEAL_CACHE_SLOTS 3,
+// DICT_BYTES 768) the app stores at most
+//   day list         6 + 2 * MAX_MENU_ITEMS          =   26 bytes
+//   meal slots       3 * (20 byte header + 4 * 256)   = 3132 bytes
+//   name dictionary  6 byte header + DICT_BYTES       =  774 bytes
+//   pre-warm keys    2 * 4                            =    8 bytes
+// or 3940 bytes in all. A write that does not fit fails the slot or the dictionary, never
+// the app; the slot is dropped and the meals are fetched again, a dropped dictionary is
+// synced again from the phone.
+#define CACHE_VERSION 5
+#define PERSIST_KEY_DAY_LIST 1
+#define PERSIST_KEY_MEAL_SLOT 10   // One header per slot: 10 .. 10 + MEAL_CACHE_SLOTS - 1
+#define PERSIST_KEY_MEAL_CHUNK 20  // Slot data split into PERSIST_DATA_MAX_LENGTH sized chunks.
+#define MEAL_CACHE_SLOTS PROFILE_MEAL_CACHE_SLOTS
+#define MEAL_CACHE_MAX_CHUNKS 4
+
+typedef struct {
+  uint8_t version;
+  uint16_t day;
+  uint16_t length;
+  uint32_t sequence;
+  uint32_t rev;
+  uint16_t dict;     // Id of the name dictionary the meal names refer to.
+} MealCacheHeader;
+
+// Name dictionary: words that recur in meal names, mirrored from the phone (see dictionary.js)
+// and persisted so they are sent only once. In a meal name, DICT_REF followed by the byte
+// i + 1 stands for entry i. Names stay encoded in the meal arena and are expanded when drawn.
+//   XFER_KIND_DICT payload: [version][id:2 LE][first entry][count] then [length][bytes] per entry
+#define DICT_DATA_VERSION 1
+#define DICT_REF 0xFF
+#define DICT_BYTES PROFILE_DICT_BYTES
+#define DICT_MAX_ENTRIES (DICT_BYTES / 5)  // The phone only adds words of four bytes or more.
+#define PERSIST_KEY_DICT 4         // DictHeader; the entries follow in chunks.
+#define PERSIST_KEY_DICT_CHUNK 40
+
+typedef struct {
+  uint16_t id;
+  uint8_t count;
+  uint16_t used;
+} DictHeader;
+
+static uint8_t s_dict_data[DICT_BYTES];           // [length][bytes] per entry.
+static uint16_t s_dict_offsets[DICT_MAX_ENTRIES];
+static DictHeader s_dict;
+static char s_title_buffer[256];                  // Expanded meal name being measured or drawn.
+
+// Chunked transfer of payloads that do not fit into one AppMessage (see sendChunked in index.js).
+// Every chunk carries XFER_ID, XFER_SEQ, XFER_OFFSET, XFER_TOTAL, XFER_KIND and XFER_DATA.
+// Chunks are accepted in order; the watch answers with a cumulative XFER_ACK (number of chunks
+// received) or an XFER_NACK with the sequence number it expects next.
+#define XFER_KIND_MEALS 1
+#define XFER_KIND_DETAILS 2
+#define XFER_KIND_MEALS_DELTA 3
+#define XFER_KIND_MEALS_PAGE 4
+#define XFER_KIND_DICT 5
+
+// Further meals of a paged list (see sendMealPage in index.js):
+//   [version][revision:4 LE][first meal][count] then count meal records as in MEALS_DATA v3
+#define MEALS_PAGE_VERSION 1
+#define MEALS_PAGE_HEADER_SIZE 7
+#define APP_MESSAGE_INBOX_SIZE PROFILE_APP_MESSAGE_INBOX_SIZE
+#define APP_MESSAGE_OUTBOX_SIZE PROFILE_APP_MESSAGE_OUTBOX_SIZE
+#define XFER_MAX_SIZE PROFILE_XFER_MAX_SIZE
+#define XFER_OVERHEAD 96  // Dictionary header and the tuples besides XFER_DATA.
+
+typedef struct {
+  uint8_t id;
+  uint8_t kind;
+  uint8_t next_seq;
+  uint16_t total;
+  uint16_t received;
+  uint8_t *buffer;
+  uint16_t day;
+  uint32_t rev;
+} Transfer;
+
+static Transfer s_transfer;
+static uint32_t s_inbox_size = APP_MESSAGE_INBOX_SIZE;
+static bool s_xfer_reply_pending = false;
+static bool s_xfer_reply_is_nack = false;
+
+// Meal details pushed in the background as XFER_KIND_DETAILS (see pushMealDetails in index.js):
+//   [version:1][count:1] then per meal
+//   [id:4 LE][name length:1][name][price length:1][price][notes length:2 LE][notes]
+// They are kept in a small LRU so selecting a meal opens its details without a round trip.
+// Notes are coded as in MEAL_NOTES: [count:1] then per note a code into the NOTE_TABLE
+// resource, or NOTE_LITERAL followed by [length:1][bytes] for notes the table does not know.
+#define DETAILS_DATA_VERSION 2
+#define NOTE_LITERAL 0xFF  // Must match NOTE_LITERAL in tools/note_table.py and notes.js.
+#define DETAIL_CACHE_ENTRIES PROFILE_DETAIL_CACHE_ENTRIES
+#define DETAIL_CACHE_BYTES PROFILE_DETAIL_CACHE_BYTES
+
+typedef struct {
+  int32_t id;
+  char *strings;       // "name\0price\0" then the coded notes, NULL if the slot is empty.
+  uint16_t size;
+  uint32_t last_used;
+} DetailCacheEntry;
+
+static DetailCacheEntry s_detail_cache[DETAIL_CACHE_ENTRIES];
+static size_t s_detail_cache_bytes = 0;
+static uint32_t s_detail_cache_clock = 0;
+
+// Performance counters shown in the diagnostics window (long-press on the day list).
+typedef enum {
+  REQUEST_DAYS,
+  REQUEST_MEALS,
+  REQUEST_DETAIL,
+  REQUEST_TYPE_COUNT
+} RequestType;
+
+typedef struct {
+  uint32_t sent_ms;       // 0 while no request is outstanding.
+  uint32_t last_ms;       // Latest request-to-receive time.
+  uint32_t max_ms;
+  uint16_t count;
+} RequestTiming;
+
+static struct {
+  RequestTiming requests[REQUEST_TYPE_COUNT];
+  uint16_t dropped;
+  AppMessageResult last_drop_reason;
+  uint16_t send_failed;
+  AppMessageResult last_send_failure;
+  size_t heap_used_max;
+  size_t heap_free_min;
+  uint16_t reloads;
+  uint32_t reload_last_ms;  // From the reload until the frame showing it was drawn.
+  uint32_t reload_max_ms;
+  uint32_t render_start_ms;
+  bool render_pending;
+} s_diag;
+
+static Layer *s_render_probe_layer = NULL;
+static Layer *s_meals_render_probe_layer = NULL;
+
+// The report sent to the phone is a one-line summary that fits the outbox with the tuple header.
+#define DIAG_REPORT_SIZE (APP_MESSAGE_OUTBOX_SIZE - 16)
+// The window shows one counter per line when its buffer holds more than the report, and the
+// report otherwise.
+#define DIAG_TEXT_SIZE PROFILE_DIAG_TEXT_SIZE
+
+static Window *s_diag_window = NULL;
+static ScrollLayer *s_diag_scroll_layer = NULL;
+static TextLayer *s_diag_text_layer = NULL;
+static char s_diag_text[DIAG_TEXT_SIZE];
+
+// Pre-warm: a wakeup shortly before lunch fetches the nearest day into the persistent cache
+// and exits again, so the next real launch shows current meals without waiting.
+#define PERSIST_KEY_PREWARM_TIME 2  // Minutes after local midnight; absent when disabled.
+#define PERSIST_KEY_PREWARM_LAST 3  // Timestamp of the last pre-warm launch.
+#define PREWARM_MIN_INTERVAL (12 * 60 * 60)  // At most one pre-warm run per half day.
+#define PREWARM_TIMEOUT_MS 60000    // Exit anyway if the phone does not deliver in time.
+#define PREWARM_RETRY_MINUTES 5     // Later slots to try when another wakeup is too close.
+static bool s_prewarm = false;      // Launched by our wakeup; nothing is shown to the user.
+static AppTimer *s_prewarm_timer = NULL;
+
+static bool s_days_stale = false;
+static bool s_meals_stale = false;
+// MEALS_UNAVAILABLE: the phone has no meals to send for the selected day, with the reason.
+#define MEALS_UNAVAILABLE_NONE 1    // No canteen serves meals that day.
+#define MEALS_UNAVAILABLE_FAILED 2  // The meals could not be fetched.
+static const char *s_meals_notice = NULL;  // Shown above the meals instead of "Updating...".
+
+// Content hashes: the phone tags the day list with DAYS_HASH and uses a hash of the meal list
+// as its revision (MEALS_REV). The watch reports what it holds, with DAYS_HASH at launch and
+// MEALS_HASH with each request, and gets DAYS_NOT_MODIFIED or MEALS_NOT_MODIFIED when it is current.
+static uint32_t s_days_hash = 0;
+#define HELLO_RETRY_MS 1000  // The phone may not be listening yet right after launch.
+#define HELLO_RETRIES 3
+static int s_hello_retries = 0;
+static uint16_t s_selected_day = DAY_NONE;
+static bool s_meals_request_pending = false;  // request_meals() found the outbox busy.
 
 static Window *s_window;
 static MenuLayer *s_menu_layer;
@@ -31,11 +365,12 @@ static Window *s_meals_window;
 static MenuLayer *s_meals_menu_layer;
 static Window *s_error_window = NULL;
 static TextLayer *s_error_text_layer = NULL;
+static char s_error_text[128];  // The message outlives the AppMessage it came with.
 static Window *s_meal_info_window = NULL;
 
-static char s_meal_info_name[128] = "";
-static char s_meal_info_price[64] = "";
-static char s_meal_info_allergens[256] = "";
+static const char *s_meal_info_name = "";      // In s_detail_arena.
+static const char *s_meal_info_price = "";
+static const char *s_meal_info_allergens = "";
 static TextLayer *s_meal_info_name_layer = NULL;
 static TextLayer *s_meal_info_price_layer = NULL;
 static TextLayer *s_meal_info_allergens_layer = NULL;
@@ -72,287 +407,1385 @@ char *strcasestr(const char *haystack, const char *needle) {
 }
 #endif
 
-// Menu callbacks
-static uint16_t menu_get_num_sections_callback(MenuLayer *menu_layer, void *data) {
-  return 1;
+static void arena_reset(Arena *arena) {
+  arena->used = 0;
 }
 
-static uint16_t menu_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
-  return s_menu_item_count; // Dynamic count
+static size_t arena_available(const Arena *arena) {
+  return arena->capacity - arena->used;
 }
 
-static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
-  if(cell_index->row < s_menu_item_count) {
-    menu_cell_basic_draw(ctx, cell_layer, s_menu_titles[cell_index->row], s_menu_subtitles[cell_index->row], NULL);
+// Copies len bytes of src into the arena as a terminated string.
+// Returns NULL if the arena is full.
+static char *arena_strndup(Arena *arena, const char *src, size_t len) {
+  if (len + 1 > arena_available(arena)) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Arena %s full (%d/%d bytes)", arena->name, (int)arena->used, (int)arena->capacity);
+    return NULL;
   }
+  char *dst = arena->base + arena->used;
+  memcpy(dst, src, len);
+  dst[len] = '\0';
+  arena->used += len + 1;
+  if (arena->used > arena->peak) {
+    arena->peak = arena->used;
+  }
+  return dst;
 }
 
-// --- Update day menu selection callback ---
-static void menu_selection_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
-  if(cell_index->row < s_menu_item_count) {
-    // When a date is selected, send a message to request the meals.
-    DictionaryIterator *out_iter;
-    AppMessageResult result = app_message_outbox_begin(&out_iter);
-    if(result == APP_MSG_OK) {
-      // Send the selected date string.
-      dict_write_cstring(out_iter, MESSAGE_KEY_SELECTED_DATE, s_menu_titles[cell_index->row]);
-      dict_write_end(out_iter);
-      app_message_outbox_send();
+// --- Name dictionary ---
+// Rebuilds the entry offsets; returns false if the entries do not match the header.
+static bool dict_index(void) {
+  uint16_t offset = 0;
+  for (int i = 0; i < s_dict.count; i++) {
+    if (i >= DICT_MAX_ENTRIES || offset >= s_dict.used || offset + 1 + s_dict_data[offset] > s_dict.used) {
+      return false;
     }
+    s_dict_offsets[i] = offset;
+    offset += 1 + s_dict_data[offset];
   }
+  return offset == s_dict.used;
 }
 
-// --- Meals menu callbacks ---
-static uint16_t meals_menu_get_num_sections_callback(MenuLayer *menu_layer, void *data) {
-  return 1;
+static void dict_load(void) {
+  DictHeader header;
+  if (persist_read_data(PERSIST_KEY_DICT, &header, sizeof(header)) != (int)sizeof(header) ||
+      header.used > DICT_BYTES) {
+    return;
+  }
+  for (int chunk = 0; chunk * PERSIST_DATA_MAX_LENGTH < header.used; chunk++) {
+    int offset = chunk * PERSIST_DATA_MAX_LENGTH;
+    int size = MIN(header.used - offset, PERSIST_DATA_MAX_LENGTH);
+    if (persist_read_data(PERSIST_KEY_DICT_CHUNK + chunk, s_dict_data + offset, size) != size) {
+      return;
+    }
+  }
+  s_dict = header;
+  if (!dict_index()) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Dropping inconsistent name dictionary");
+    s_dict = (DictHeader){ 0 };
+  }
 }
 
-static uint16_t meals_menu_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
-  return s_meal_count;
+static void dict_store(void) {
+  // Drop the header first so a partially written dictionary is never read back.
+  persist_delete(PERSIST_KEY_DICT);
+  for (int chunk = 0; chunk * PERSIST_DATA_MAX_LENGTH < s_dict.used; chunk++) {
+    int offset = chunk * PERSIST_DATA_MAX_LENGTH;
+    int size = MIN(s_dict.used - offset, PERSIST_DATA_MAX_LENGTH);
+    if (persist_write_data(PERSIST_KEY_DICT_CHUNK + chunk, s_dict_data + offset, size) != size) {
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Could not store the name dictionary");
+      return;
+    }
+  }
+  if (persist_write_data(PERSIST_KEY_DICT, &s_dict, sizeof(s_dict)) != (int)sizeof(s_dict)) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Could not store the name dictionary");
+  }
 }
 
-static void meals_menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
-  if(cell_index->row < s_meal_count) {
-    GRect bounds = layer_get_bounds(cell_layer);
-    
-    // Draw the bitmap icon if available.
-    int icon_size = 30;
-    int icon_offset = 5;
-    if(s_meal_bitmaps[cell_index->row] != NULL) {
-      graphics_context_set_compositing_mode(ctx, GCompOpSet);
-      GRect icon_bounds = GRect(icon_offset, (bounds.size.h - icon_size) / 2, icon_size, icon_size);
-      graphics_draw_bitmap_in_rect(ctx, s_meal_bitmaps[cell_index->row], icon_bounds);
-    }
-    
-    // Calculate textbox bounds (shift right if icon is drawn).
-    GRect text_bounds = bounds;
-    if(s_meal_bitmaps[cell_index->row] != NULL) {
-      text_bounds.origin.x += icon_size + 2 * icon_offset;
-      text_bounds.size.w -= icon_size + 2 * icon_offset;
+// Appends the entries of an XFER_KIND_DICT payload. A payload for another dictionary id
+// replaces the dictionary; entries the watch already holds are skipped, as the phone may
+// resend them before it has seen the watch's count.
+static void handle_dict_data(const uint8_t *data, uint16_t length) {
+  if (length < 5 || data[0] != DICT_DATA_VERSION) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Unsupported dictionary data version: %d", length ? (int)data[0] : -1);
+    return;
+  }
+  uint16_t id = data[1] | (data[2] << 8);
+  int first = data[3];
+  if (id != s_dict.id) {
+    if (first != 0) {
+      return;
     }
-    
-    // Use a small font and calculate its height.
-    const GFont small_font = fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
-    int small_font_height = graphics_text_layout_get_content_size("A", small_font, 
-                                  GRect(0, 0, text_bounds.size.w, 1000),
-                                  GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft).h;
-    text_bounds.size.h = small_font_height;
-    
-    // Set text color: white when highlighted, black otherwise.
-    if(menu_cell_layer_is_highlighted(cell_layer)) {
-      graphics_context_set_text_color(ctx, GColorWhite);
-    } else {
-      graphics_context_set_text_color(ctx, GColorBlack);
+    // Cached meals refer to the old entries and no longer match.
+    s_dict = (DictHeader){ .id = id };
+  }
+  if (first > s_dict.count) {
+    return;
+  }
+  const uint8_t *ptr = data + 5;
+  const uint8_t *end = data + length;
+  for (int i = first; i < first + data[4]; i++) {
+    if (ptr >= end || end - ptr - 1 < *ptr) break;
+    uint8_t entry_len = 1 + *ptr;
+    if (i >= s_dict.count) {
+      if (s_dict.count >= DICT_MAX_ENTRIES || s_dict.used + entry_len > DICT_BYTES) {
+        APP_LOG(APP_LOG_LEVEL_WARNING, "Name dictionary full at %d entries", (int)s_dict.count);
+        break;
+      }
+      memcpy(s_dict_data + s_dict.used, ptr, entry_len);
+      s_dict_offsets[s_dict.count++] = s_dict.used;
+      s_dict.used += entry_len;
     }
-    
-    // Draw the meal title on one line.
-    graphics_draw_text(ctx, s_meal_titles[cell_index->row], small_font, text_bounds,
-                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
-    
-    // Optional: Draw the subtitle (price) on a second line with smaller font.
-    const GFont subtitle_font = fonts_get_system_font(FONT_KEY_GOTHIC_18);
-    int subtitle_font_height = graphics_text_layout_get_content_size("A", subtitle_font, 
-                                      GRect(0, 0, text_bounds.size.w, 1000),
-                                      GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft).h;
-    GRect subtitle_bounds = text_bounds;
-    subtitle_bounds.origin.y += small_font_height + 2; // adjust spacing as needed
-    subtitle_bounds.size.h = subtitle_font_height;
-    graphics_draw_text(ctx, s_meal_subtitles[cell_index->row], subtitle_font, subtitle_bounds,
-                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
-    
+    ptr += entry_len;
   }
+  dict_store();
 }
 
-static void meals_menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *context) {
-  if(cell_index->row < s_meal_count) {
-    DictionaryIterator *out_iter;
-    AppMessageResult result = app_message_outbox_begin(&out_iter);
-    if(result == APP_MSG_OK) {
-      // Send the selected meal id back to JS.
-      dict_write_int(out_iter, MESSAGE_KEY_MEAL_ID, &s_meal_ids[cell_index->row], sizeof(int), true);
-      dict_write_end(out_iter);
-      app_message_outbox_send();
-    } else {
-      APP_LOG(APP_LOG_LEVEL_ERROR, "Error sending meal ID: %d", (int)result);
+// Expands the dictionary references in name into s_title_buffer, cut at a character
+// boundary if it does not fit. Names without references are returned as they are.
+static const char *dict_expand(const char *name) {
+  if (!name || !strchr(name, DICT_REF)) {
+    return name;
+  }
+  size_t used = 0;
+  for (const uint8_t *ptr = (const uint8_t *)name; *ptr && used < sizeof(s_title_buffer) - 1; ptr++) {
+    if (*ptr != DICT_REF) {
+      s_title_buffer[used++] = *ptr;
+      continue;
+    }
+    if (!ptr[1]) break;
+    int entry = *++ptr - 1;
+    if (entry >= s_dict.count) {
+      continue;  // Dictionary lost or behind; the phone resyncs with the next request.
+    }
+    const uint8_t *word = s_dict_data + s_dict_offsets[entry];
+    size_t word_len = MIN((size_t)word[0], sizeof(s_title_buffer) - 1 - used);
+    memcpy(s_title_buffer + used, word + 1, word_len);
+    used += word_len;
+  }
+  if (used == sizeof(s_title_buffer) - 1) {
+    // Drop a character that was cut off at the end.
+    size_t lead = used;
+    while (lead > 0 && ((uint8_t)s_title_buffer[lead - 1] & 0xC0) == 0x80) {
+      lead--;
+    }
+    if (lead > 0) {
+      uint8_t c = s_title_buffer[lead - 1];
+      size_t char_len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+      if (lead - 1 + char_len > used) {
+        used = lead - 1;
+      }
     }
   }
+  s_title_buffer[used] = '\0';
+  return s_title_buffer;
 }
 
-// --- Meals window load/unload ---
-static void meals_window_load(Window *window) {
-  Layer *window_layer = window_get_root_layer(window);
-  GRect bounds = layer_get_bounds(window_layer);
-  
-  s_meals_menu_layer = menu_layer_create(bounds);
-  menu_layer_set_callbacks(s_meals_menu_layer, NULL, (MenuLayerCallbacks){
-    .get_num_sections = meals_menu_get_num_sections_callback,
-    .get_num_rows = meals_menu_get_num_rows_callback,
-    .draw_row = meals_menu_draw_row_callback,
-    .select_click = meals_menu_select_callback,
-  });
-  menu_layer_set_click_config_onto_window(s_meals_menu_layer, window);
-  layer_add_child(window_layer, menu_layer_get_layer(s_meals_menu_layer));
+// --- Diagnostics ---
+static uint32_t diag_now_ms(void) {
+  time_t seconds;
+  uint16_t millis;
+  time_ms(&seconds, &millis);
+  return (uint32_t)seconds * 1000 + millis;
 }
 
-static void meals_window_unload(Window *window) {
-  menu_layer_destroy(s_meals_menu_layer);
-  // Free meal data.
-  for (int i = 0; i < s_meal_count; i++) {
-    free(s_meal_titles[i]);
-    free(s_meal_subtitles[i]);
-    if (s_meal_bitmaps[i]) {
-      gbitmap_destroy(s_meal_bitmaps[i]);
-      s_meal_bitmaps[i] = NULL;
-    }
+static void diag_sample_heap(void) {
+  size_t used = heap_bytes_used();
+  size_t free_bytes = heap_bytes_free();
+  if (used > s_diag.heap_used_max) {
+    s_diag.heap_used_max = used;
+  }
+  if (s_diag.heap_free_min == 0 || free_bytes < s_diag.heap_free_min) {
+    s_diag.heap_free_min = free_bytes;
   }
-  s_meal_count = 0;
 }
 
-static void create_meals_window() {
-  s_meals_window = window_create();
-  window_set_window_handlers(s_meals_window, (WindowHandlers) {
-    .load = meals_window_load,
-    .unload = meals_window_unload
-  });
+static void diag_request_sent(RequestType type) {
+  s_diag.requests[type].sent_ms = diag_now_ms();
 }
 
-// Minimal JSON parser to extract dates.
-// This parses a JSON array like ["01.01.2023", "02.01.2023", …]
-static void parse_day_list(const char *json) {
-  s_menu_item_count = 0;
-  const char *ptr = json;
-  
-  // Skip any whitespace and the leading '[' if present.
-  while(*ptr && isspace((unsigned char)*ptr)) { ptr++; }
-  if(*ptr == '[') { ptr++; }
-  
-  while(*ptr && s_menu_item_count < MAX_MENU_ITEMS) {
-    const char *start = strchr(ptr, '\"');
-    if(!start) break;
-    start++;  // move past the opening quote
-    const char *end = strchr(start, '\"');
-    if(!end) break;  // malformed JSON
-    
-    size_t len = end - start;
-    char *date_string = malloc(len + 1);
-    if(date_string) {
-      strncpy(date_string, start, len);
-      date_string[len] = '\0';
-      s_menu_titles[s_menu_item_count] = date_string;
-      s_menu_item_count++;
+static void diag_response_received(RequestType type) {
+  RequestTiming *timing = &s_diag.requests[type];
+  if (timing->sent_ms) {
+    timing->last_ms = diag_now_ms() - timing->sent_ms;
+    if (timing->last_ms > timing->max_ms) {
+      timing->max_ms = timing->last_ms;
     }
-    ptr = end + 1;
+    timing->sent_ms = 0;
   }
+  timing->count++;
+  diag_sample_heap();
 }
 
-// Minimal JSON parser to extract weekday names.
-// This parses a JSON array like ["Sun", "Mon", …]
-static void parse_weekday_list(const char *json) {
-  int index = 0;
-  const char *ptr = json;
-  
-  // Skip any whitespace and the leading '[' if present.
-  while(*ptr && isspace((unsigned char)*ptr)) { ptr++; }
-  if(*ptr == '[') { ptr++; }
-  
-  while(*ptr && index < s_menu_item_count) {
-    const char *start = strchr(ptr, '\"');
-    if(!start) break;
-    start++;  // move past the opening quote
-    const char *end = strchr(start, '\"');
-    if(!end) break;  // malformed JSON
-    
-    size_t len = end - start;
-    char *weekday_string = malloc(len + 1);
-    if(weekday_string) {
-      strncpy(weekday_string, start, len);
-      weekday_string[len] = '\0';
-      s_menu_subtitles[index] = weekday_string;
-      index++;
+// Starts the render clock for a reload that began at start_ms. Reloads before the next frame
+// are counted with the first one.
+static void diag_render_started(uint32_t start_ms) {
+  if (!s_diag.render_pending) {
+    s_diag.render_start_ms = start_ms;
+    s_diag.render_pending = true;
+  }
+}
+
+// Update proc of an empty layer above each menu: it is drawn after the menu's rows, so it stops
+// the render clock once the frame showing the reload is complete.
+static void diag_render_probe_update_proc(Layer *layer, GContext *ctx) {
+  if (!s_diag.render_pending) {
+    return;
+  }
+  s_diag.render_pending = false;
+  s_diag.reload_last_ms = diag_now_ms() - s_diag.render_start_ms;
+  if (s_diag.reload_last_ms > s_diag.reload_max_ms) {
+    s_diag.reload_max_ms = s_diag.reload_last_ms;
+  }
+  s_diag.reloads++;
+}
+
+static Layer *diag_render_probe_create(Layer *window_layer) {
+  Layer *probe = layer_create(layer_get_bounds(window_layer));
+  layer_set_update_proc(probe, diag_render_probe_update_proc);
+  layer_add_child(window_layer, probe);
+  return probe;
+}
+
+static void diag_reload_menu(MenuLayer *menu_layer) {
+  diag_render_started(diag_now_ms());
+  menu_layer_reload_data(menu_layer);
+}
+
+#if DIAG_TEXT_SIZE > DIAG_REPORT_SIZE
+static void diag_format(char *buffer, size_t size) {
+  static const char *names[REQUEST_TYPE_COUNT] = { "Days", "Meals", "Detail" };
+  int pos = 0;
+  for (int i = 0; i < REQUEST_TYPE_COUNT && pos < (int)size; i++) {
+    pos += snprintf(buffer + pos, size - pos, "%s: %d recv, last %dms, max %dms\n", names[i],
+                    (int)s_diag.requests[i].count, (int)s_diag.requests[i].last_ms, (int)s_diag.requests[i].max_ms);
+  }
+  if (pos < (int)size) {
+    pos += snprintf(buffer + pos, size - pos, "Dropped: %d (last reason %d)\nSend failed: %d (last reason %d)\n",
+                    (int)s_diag.dropped, (int)s_diag.last_drop_reason,
+                    (int)s_diag.send_failed, (int)s_diag.last_send_failure);
+  }
+  if (pos < (int)size) {
+    pos += snprintf(buffer + pos, size - pos, "Heap: %d used, %d free\nPeak used %d, min free %d\n",
+                    (int)heap_bytes_used(), (int)heap_bytes_free(),
+                    (int)s_diag.heap_used_max, (int)s_diag.heap_free_min);
+  }
+  if (pos < (int)size) {
+    snprintf(buffer + pos, size - pos, "Reloads: %d, last %dms, max %dms",
+             (int)s_diag.reloads, (int)s_diag.reload_last_ms, (int)s_diag.reload_max_ms);
+  }
+}
+#endif
+
+// Formats the counters as one line of at most DIAG_REPORT_SIZE - 1 characters.
+static void diag_format_report(char *buffer, size_t size) {
+  snprintf(buffer, size, "days %d/%d/%dms meals %d/%d/%dms detail %d/%d/%dms drop %d(%d) fail %d(%d) "
+                         "heap %d/%d peak %d min %d reload %d/%d/%dms",
+           (int)s_diag.requests[REQUEST_DAYS].count, (int)s_diag.requests[REQUEST_DAYS].last_ms,
+           (int)s_diag.requests[REQUEST_DAYS].max_ms,
+           (int)s_diag.requests[REQUEST_MEALS].count, (int)s_diag.requests[REQUEST_MEALS].last_ms,
+           (int)s_diag.requests[REQUEST_MEALS].max_ms,
+           (int)s_diag.requests[REQUEST_DETAIL].count, (int)s_diag.requests[REQUEST_DETAIL].last_ms,
+           (int)s_diag.requests[REQUEST_DETAIL].max_ms,
+           (int)s_diag.dropped, (int)s_diag.last_drop_reason, (int)s_diag.send_failed, (int)s_diag.last_send_failure,
+           (int)heap_bytes_used(), (int)heap_bytes_free(), (int)s_diag.heap_used_max, (int)s_diag.heap_free_min,
+           (int)s_diag.reloads, (int)s_diag.reload_last_ms, (int)s_diag.reload_max_ms);
+}
+
+// Stats hook: logs the peak usage of every arena.
+static void arena_report_stats(void) {
+  const Arena *arenas[] = { &s_day_arena, &s_meal_arena, &s_detail_arena };
+  for (size_t i = 0; i < sizeof(arenas) / sizeof(arenas[0]); i++) {
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Arena %s: %d used, %d peak, %d capacity", arenas[i]->name,
+            (int)arenas[i]->used, (int)arenas[i]->peak, (int)arenas[i]->capacity);
+  }
+}
+
+static int parse_meals_data(const uint8_t *data, uint16_t length);
+static void free_meals(void);
+static void classify_meals(void);
+static void show_meals_window(void);
+static bool cache_load_meals(uint16_t day);
+static void cache_store_meals(uint16_t day, const uint8_t *data, uint16_t length, uint32_t rev);
+static void show_meal_info_window_separated(const char *name, const char *price,
+                                            const uint8_t *notes, uint16_t notes_len);
+static void governor_check(void);
+static void governor_step_down(void);
+
+// --- App state ---
+// The day list, meals, meal detail and error message are slices of the app state, each with
+// a version. Handlers update the data and call state_changed(); the views below subscribe to
+// the slice they render and are laid out again once per event loop turn, only when their
+// slice moved past the version they show. Deltas and pages update the meals menu in place
+// themselves, keeping the selection, and do not go through here.
+typedef enum {
+  SLICE_DAYS,
+  SLICE_MEALS,
+  SLICE_DETAIL,
+  SLICE_ERROR,
+  SLICE_COUNT
+} StateSlice;
+
+typedef struct {
+  StateSlice slice;
+  void (*render)(void);
+  uint16_t rendered;  // Version of the slice the view shows.
+} StateView;
+
+static void days_view_render(void);
+static void meals_view_render(void);
+static void detail_view_render(void);
+static void error_view_render(void);
+
+static uint16_t s_state_versions[SLICE_COUNT];
+static AppTimer *s_state_timer = NULL;
+static StateView s_views[] = {
+  { SLICE_DAYS, days_view_render, 0 },
+  { SLICE_MEALS, meals_view_render, 0 },
+  { SLICE_DETAIL, detail_view_render, 0 },
+  { SLICE_ERROR, error_view_render, 0 },
+};
+
+static void state_flush(void *data) {
+  s_state_timer = NULL;
+  for (size_t i = 0; i < sizeof(s_views) / sizeof(s_views[0]); i++) {
+    StateView *view = &s_views[i];
+    if (view->rendered != s_state_versions[view->slice]) {
+      view->rendered = s_state_versions[view->slice];
+      view->render();
     }
-    ptr = end + 1;
   }
 }
-// Helper: Parse a JSON string array (e.g. ["Foo","Bar",...]) into dst.
-// Returns the number of items parsed.
-static int parse_string_array(const char *json, char **dst, int max_count) {
-  int count = 0;
-  const char *ptr = json;
-  while (*ptr && count < max_count) {
-    const char *start = strchr(ptr, '\"');
-    if (!start) break;
-    start++;  // move past the opening quote
-    const char *end = strchr(start, '\"');
-    if (!end) break;  // malformed JSON
-    size_t len = end - start;
-    dst[count] = malloc(len + 1);
-    if (dst[count]) {
-      strncpy(dst[count], start, len);
-      dst[count][len] = '\0';
-      count++;
+
+static void state_changed(StateSlice slice) {
+  s_state_versions[slice]++;
+  if (!s_state_timer) {
+    s_state_timer = app_timer_register(0, state_flush, NULL);
+  }
+}
+
+// A view that just built its layers from the current data is up to date.
+static void state_rendered(StateSlice slice) {
+  for (size_t i = 0; i < sizeof(s_views) / sizeof(s_views[0]); i++) {
+    if (s_views[i].slice == slice) {
+      s_views[i].rendered = s_state_versions[slice];
     }
-    ptr = end + 1;
   }
-  return count;
 }
 
-// Helper: Parse a JSON numeric array (e.g. [123,456,...]) into dst.
-// Returns the number of items parsed.
-static int parse_int_array(const char *json, int *dst, int max_count) {
-  int count = 0;
-  const char *ptr = json;
-  while (*ptr && count < max_count) {
-    // Skip non-digit characters.
-    while (*ptr && !isdigit((unsigned char)*ptr) && *ptr != '-') {
-      ptr++;
+// --- Meal detail LRU ---
+static void detail_cache_evict(DetailCacheEntry *entry) {
+  if (entry->strings) {
+    s_detail_cache_bytes -= entry->size;
+    free(entry->strings);
+    entry->strings = NULL;
+  }
+}
+
+static DetailCacheEntry *detail_cache_find(int32_t id) {
+  for (int i = 0; i < DETAIL_CACHE_ENTRIES; i++) {
+    if (s_detail_cache[i].strings && s_detail_cache[i].id == id) {
+      s_detail_cache[i].last_used = ++s_detail_cache_clock;
+      return &s_detail_cache[i];
     }
-    if (!*ptr) break;
-    int value = atoi(ptr);
-    dst[count] = value;
-    count++;
-    // Skip current number.
-    while (*ptr && (isdigit((unsigned char)*ptr) || *ptr == '-')) {
-      ptr++;
+  }
+  return NULL;
+}
+
+// Returns the least recently used occupied entry, or NULL if the cache is empty.
+static DetailCacheEntry *detail_cache_least_recently_used(void) {
+  DetailCacheEntry *lru = NULL;
+  for (int i = 0; i < DETAIL_CACHE_ENTRIES; i++) {
+    if (s_detail_cache[i].strings && (!lru || s_detail_cache[i].last_used < lru->last_used)) {
+      lru = &s_detail_cache[i];
     }
   }
-  return count;
+  return lru;
 }
 
-// --- New: Back button handler for error window ---
-static void error_window_back_handler(ClickRecognizerRef recognizer, void *context) {
-  // Exit the app.
-  window_stack_pop_all(true);
+// Returns an empty entry, evicting the least recently used one if all are taken.
+static DetailCacheEntry *detail_cache_free_entry(void) {
+  for (int i = 0; i < DETAIL_CACHE_ENTRIES; i++) {
+    if (!s_detail_cache[i].strings) {
+      return &s_detail_cache[i];
+    }
+  }
+  DetailCacheEntry *lru = detail_cache_least_recently_used();
+  detail_cache_evict(lru);
+  return lru;
 }
 
-static void error_window_click_config_provider(void *context) {
-  window_single_click_subscribe(BUTTON_ID_BACK, error_window_back_handler);
+static void detail_cache_store(int32_t id, const uint8_t *name, uint8_t name_len, const uint8_t *price,
+                               uint8_t price_len, const uint8_t *notes, uint16_t notes_len) {
+  uint16_t size = name_len + price_len + notes_len + 2;
+  if (size > DETAIL_CACHE_BYTES) {
+    return;
+  }
+  DetailCacheEntry *entry = detail_cache_find(id);
+  if (entry) {
+    detail_cache_evict(entry);
+  }
+  // Evict least recently used details until the new record fits the byte budget.
+  while (s_detail_cache_bytes + size > DETAIL_CACHE_BYTES) {
+    DetailCacheEntry *lru = detail_cache_least_recently_used();
+    if (!lru) break;
+    detail_cache_evict(lru);
+  }
+  if (!entry) {
+    entry = detail_cache_free_entry();
+  }
+  char *strings = malloc(size);
+  if (!strings) {
+    return;
+  }
+  char *ptr = strings;
+  memcpy(ptr, name, name_len);
+  ptr += name_len;
+  *ptr++ = '\0';
+  memcpy(ptr, price, price_len);
+  ptr += price_len;
+  *ptr++ = '\0';
+  memcpy(ptr, notes, notes_len);
+  *entry = (DetailCacheEntry){ .id = id, .strings = strings, .size = size, .last_used = ++s_detail_cache_clock };
+  s_detail_cache_bytes += size;
 }
 
-// --- Updated error window functions ---
-static void error_window_unload(Window *window) {
-  text_layer_destroy(s_error_text_layer);
-  window_destroy(s_error_window);
-  s_error_window = NULL;
+static void detail_cache_clear(void) {
+  for (int i = 0; i < DETAIL_CACHE_ENTRIES; i++) {
+    detail_cache_evict(&s_detail_cache[i]);
+  }
 }
 
-static void show_error_window(const char *error_msg) {
-  // If an error window is already displayed, remove it.
-  if (s_error_window) {
-    window_stack_remove(s_error_window, true);
+// Decodes an XFER_KIND_DETAILS payload into the detail LRU.
+static void parse_details_data(const uint8_t *data, uint16_t length) {
+  if (length < 2 || data[0] != DETAILS_DATA_VERSION) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Unsupported details data version: %d", length ? (int)data[0] : -1);
+    return;
   }
-  s_error_window = window_create();
+  const uint8_t *ptr = data + 2;
+  const uint8_t *end = data + length;
+  for (int i = 0; i < data[1]; i++) {
+    if (end - ptr < 5) break;
+    int32_t id = (int32_t)(ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24));
+    uint8_t name_len = ptr[4];
+    const uint8_t *name = ptr + 5;
+    if (end - name < name_len + 1) break;
+    uint8_t price_len = name[name_len];
+    const uint8_t *price = name + name_len + 1;
+    if (end - price < price_len + 2) break;
+    uint16_t notes_len = price[price_len] | (price[price_len + 1] << 8);
+    const uint8_t *notes = price + price_len + 2;
+    if (end - notes < notes_len) break;
+    detail_cache_store(id, name, name_len, price, price_len, notes, notes_len);
+    ptr = notes + notes_len;
+  }
+}
 
-#ifdef PBL_ROUND
-  // For round devices like Pebble Time Round, center the text.
-  GRect bounds = layer_get_bounds(window_get_root_layer(s_error_window));
+static int16_t stale_header_height_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
+  return s_days_stale ? MENU_CELL_BASIC_HEADER_HEIGHT : 0;
+}
+
+static void stale_header_draw_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *data) {
+  menu_cell_basic_header_draw(ctx, cell_layer, "Updating...");
+}
+
+// --- Icon cache ---
+// Unloads icons that no meal row references anymore.
+static void icon_cache_trim(void) {
+  for (int i = 0; i < ICON_COUNT; i++) {
+    if (s_icon_cache[i].bitmap && s_icon_cache[i].refs == 0) {
+      gbitmap_destroy(s_icon_cache[i].bitmap);
+      s_icon_cache[i].bitmap = NULL;
+    }
+  }
+}
+
+// Returns a shared bitmap for type, loading it on first use. Pair with icon_cache_release().
+static GBitmap *icon_cache_acquire(IconType type) {
+  IconCacheEntry *entry = &s_icon_cache[type];
+  if (s_mem_level >= MEM_LEVEL_NO_ICONS) {
+    return NULL;
+  }
+  if (!entry->bitmap) {
+    if (heap_bytes_free() < ICON_CACHE_MIN_FREE_HEAP) {
+      icon_cache_trim();
+    }
+    entry->bitmap = gbitmap_create_with_resource(s_icon_resources[type]);
+    if (!entry->bitmap) {
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Could not load icon %d", (int)type);
+      return NULL;
+    }
+  }
+  entry->refs++;
+  return entry->bitmap;
+}
+
+// Drops a reference; the bitmap stays loaded until icon_cache_trim().
+static void icon_cache_release(GBitmap *bitmap) {
+  for (int i = 0; i < ICON_COUNT; i++) {
+    if (bitmap && s_icon_cache[i].bitmap == bitmap && s_icon_cache[i].refs > 0) {
+      s_icon_cache[i].refs--;
+      return;
+    }
+  }
+}
+
+// Menu callbacks
+static uint16_t menu_get_num_sections_callback(MenuLayer *menu_layer, void *data) {
+  return 1;
+}
+
+static uint16_t menu_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
+  return s_menu_item_count; // Dynamic count
+}
+
+static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+  if(cell_index->row < s_menu_item_count) {
+    menu_cell_basic_draw(ctx, cell_layer, s_menu_titles[cell_index->row], s_menu_subtitles[cell_index->row], NULL);
+  }
+}
+
+// Asks the phone for the meals of day.
+static void request_meals(uint16_t day) {
+  s_selected_day = day;
+  diag_request_sent(REQUEST_MEALS);
+  DictionaryIterator *out_iter;
+  AppMessageResult result = app_message_outbox_begin(&out_iter);
+  // Busy, e.g. with the ack of the transfer that asked for a full list; retried from the
+  // outbox sent/failed handlers.
+  s_meals_request_pending = result != APP_MSG_OK;
+  if(result == APP_MSG_OK) {
+    // Send the selected day and how large a chunk we can take.
+    dict_write_uint16(out_iter, MESSAGE_KEY_SELECTED_DAY, day);
+    dict_write_uint16(out_iter, MESSAGE_KEY_XFER_CHUNK_SIZE, s_inbox_size - XFER_OVERHEAD);
+    // The phone syncs the dictionary entries we are missing before it sends the meals.
+    dict_write_uint16(out_iter, MESSAGE_KEY_DICT_ID, s_dict.id);
+    dict_write_uint8(out_iter, MESSAGE_KEY_DICT_COUNT, s_dict.count);
+    dict_write_uint16(out_iter, MESSAGE_KEY_DICT_CAPACITY, DICT_BYTES);
+    // The revision is a content hash: the phone answers MEALS_NOT_MODIFIED when it still
+    // matches, and with a delta against a complete list otherwise.
+    if (s_meals_rev) {
+      dict_write_uint32(out_iter, MESSAGE_KEY_MEALS_HASH, s_meals_rev);
+    }
+    if (s_meals_rev && s_meals_first == 0 && s_meal_count == s_meal_total) {
+      dict_write_uint32(out_iter, MESSAGE_KEY_MEALS_REV, s_meals_rev);
+    }
+    dict_write_end(out_iter);
+    app_message_outbox_send();
+  }
+}
+
+// --- Update day menu selection callback ---
+static void menu_selection_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
+  if(cell_index->row < s_menu_item_count) {
+    uint16_t day = s_menu_days[cell_index->row];
+    // Show the cached meals right away while the phone fetches fresh ones.
+    s_meals_rev = 0;
+    if (cache_load_meals(day)) {
+      s_meals_stale = true;
+      show_meals_window();
+    }
+    // When a date is selected, send a message to request the meals.
+    request_meals(day);
+  }
+}
+
+// Meals held at once and meals per page under the current memory level.
+static int meals_capacity(void) {
+  return s_mem_level >= MEM_LEVEL_FEW_ROWS ? MAX_MEALS / 2 : MAX_MEALS;
+}
+
+static int meals_page_size(void) {
+  return s_mem_level >= MEM_LEVEL_FEW_ROWS ? MEALS_PAGE_SIZE / 2 : MEALS_PAGE_SIZE;
+}
+
+// --- Meals menu callbacks ---
+// List index of the meal in a menu cell, or -1 if the cell has no meal.
+static int meal_index(const MenuIndex *cell_index) {
+  if (cell_index->section >= s_section_count) {
+    return -1;
+  }
+  int index = s_section_first[cell_index->section] + cell_index->row;
+  return index < s_section_first[cell_index->section + 1] ? index : -1;
+}
+
+// Position of a list index in the meal arrays, or -1 if that page is not loaded.
+static int meal_slot(int index) {
+  if (index < s_meals_first || index >= s_meals_first + s_meal_count) {
+    return -1;
+  }
+  return index - s_meals_first;
+}
+
+// Selects the meal at list index without animation.
+static void meals_select_index(int index) {
+  for (int i = 0; index >= 0 && i < s_section_count; i++) {
+    if (index < s_section_first[i + 1]) {
+      menu_layer_set_selected_index(s_meals_menu_layer, MenuIndex(i, index - s_section_first[i]),
+                                    MenuRowAlignNone, false);
+      return;
+    }
+  }
+}
+
+static uint16_t meals_menu_get_num_sections_callback(MenuLayer *menu_layer, void *data) {
+  return s_section_count > 0 ? s_section_count : 1;
+}
+
+static uint16_t meals_menu_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
+  if (section_index >= s_section_count) {
+    return 0;
+  }
+  return s_section_first[section_index + 1] - s_section_first[section_index];
+}
+
+// Status shown in the first section's header: "Updating..." while cached meals are shown,
+// then why the phone had no meals to send, if it had none.
+static const char *meals_status(void) {
+  return s_meals_stale ? "Updating..." : s_meals_notice;
+}
+
+static int16_t meals_menu_get_header_height_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
+  bool named = section_index < s_section_count && s_section_names[section_index];
+  return (named || (section_index == 0 && meals_status())) ? MENU_CELL_BASIC_HEADER_HEIGHT : 0;
+}
+
+static void meals_menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *data) {
+  const char *name = section_index < s_section_count ? s_section_names[section_index] : NULL;
+  if (section_index == 0 && meals_status()) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%s%s%s", name ? name : "", name ? " - " : "", meals_status());
+    menu_cell_basic_header_draw(ctx, cell_layer, buffer);
+  } else {
+    menu_cell_basic_header_draw(ctx, cell_layer, name);
+  }
+}
+
+// Long press jumps to the first meal of the next canteen.
+static void meals_menu_long_click_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
+  if (s_section_count < 2) {
+    return;
+  }
+  uint16_t section = cell_index->section;
+  do {
+    section = (section + 1) % s_section_count;
+  } while (section != cell_index->section && s_section_first[section] == s_section_first[section + 1]);
+  menu_layer_set_selected_index(menu_layer, MenuIndex(section, 0), MenuRowAlignTop, true);
+}
+
+static MealColumn meal_column(int i) {
+  return s_meal_bitmaps[i] ? MEAL_COLUMN_BESIDE_ICON : MEAL_COLUMN_FULL_WIDTH;
+}
+
+// Measures the title of meal i in both columns; returns whether its row height changed.
+static bool meals_measure_row(int i) {
+  MealRowLayout *row = &s_meal_rows[i];
+  int16_t old_height = row->generation == s_meals_layout_generation ? row->title_height[meal_column(i)] : 0;
+  const char *title = dict_expand(s_meal_titles[i]);
+  for (int column = 0; column < MEAL_COLUMN_COUNT; column++) {
+    GRect box = s_meal_title_columns[column];
+    box.size.h = s_meal_title_line_height * MEAL_TITLE_MAX_LINES;
+    int16_t height = graphics_text_layout_get_content_size(title, s_meal_title_font, box,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft).h;
+    row->title_height[column] = height < s_meal_title_line_height ? s_meal_title_line_height : height;
+  }
+  row->generation = s_meals_layout_generation;
+  return row->title_height[meal_column(i)] != old_height;
+}
+
+// Layout of meal i in the current generation, measured on first use.
+static const MealRowLayout *meals_row_layout(int i) {
+  if (s_meal_rows[i].generation != s_meals_layout_generation) {
+    meals_measure_row(i);
+  }
+  return &s_meal_rows[i];
+}
+
+// Drops the row layouts of the previous meal list.
+static void meals_layout_invalidate(void) {
+  if (++s_meals_layout_generation == 0) {
+    s_meals_layout_generation = 1;  // 0 marks rows never measured.
+  }
+}
+
+// Sets up fonts and text columns for a menu width; rows are measured as the menu asks for them.
+static void meals_layout_rows(int16_t width) {
+  if (!s_meal_title_font) {
+    s_meal_title_font = fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
+    s_meal_price_font = fonts_get_system_font(FONT_KEY_GOTHIC_18);
+    s_meal_title_line_height = graphics_text_layout_get_content_size("A", s_meal_title_font,
+                                  GRect(0, 0, width, 1000),
+                                  GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft).h;
+    s_meal_price_line_height = graphics_text_layout_get_content_size("A", s_meal_price_font,
+                                  GRect(0, 0, width, 1000),
+                                  GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft).h;
+  }
+  if (s_meal_title_columns[MEAL_COLUMN_FULL_WIDTH].size.w != width) {
+    int16_t indent = MEAL_ICON_SIZE + 2 * MEAL_ICON_OFFSET;
+    s_meal_title_columns[MEAL_COLUMN_FULL_WIDTH] = GRect(0, MEAL_ROW_PADDING, width, 0);
+    s_meal_title_columns[MEAL_COLUMN_BESIDE_ICON] = GRect(indent, MEAL_ROW_PADDING, width - indent, 0);
+    meals_layout_invalidate();
+  }
+}
+
+static int16_t meals_menu_get_cell_height_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
+  int index = meal_index(cell_index);
+  if (index < 0) {
+    return 0;
+  }
+  index = meal_slot(index);
+  if (index < 0) {
+    // Placeholder until the page arrives.
+    return 2 * MEAL_ROW_PADDING + s_meal_title_line_height + 2 + s_meal_price_line_height;
+  }
+  return 2 * MEAL_ROW_PADDING + meals_row_layout(index)->title_height[meal_column(index)] + 2 +
+         s_meal_price_line_height;
+}
+
+static void meals_menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+  int index = meal_index(cell_index);
+  if (index >= 0 && meal_slot(index) < 0) {
+    GRect bounds = layer_get_bounds(cell_layer);
+    graphics_context_set_text_color(ctx, menu_cell_layer_is_highlighted(cell_layer) ? GColorWhite : GColorBlack);
+    graphics_draw_text(ctx, "Loading...", s_meal_price_font,
+                       GRect(MEAL_ICON_SIZE + 2 * MEAL_ICON_OFFSET, MEAL_ROW_PADDING, bounds.size.w, s_meal_price_line_height),
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+    return;
+  }
+  index = meal_slot(index);
+  if(index >= 0) {
+    GRect bounds = layer_get_bounds(cell_layer);
+    
+    // Draw the bitmap icon if available.
+    if(s_meal_bitmaps[index] != NULL) {
+      graphics_context_set_compositing_mode(ctx, GCompOpSet);
+      GRect icon_bounds = GRect(MEAL_ICON_OFFSET, (bounds.size.h - MEAL_ICON_SIZE) / 2, MEAL_ICON_SIZE, MEAL_ICON_SIZE);
+      graphics_draw_bitmap_in_rect(ctx, s_meal_bitmaps[index], icon_bounds);
+    }
+    
+    // Title rect of the row's column, beside the icon if one is drawn.
+    MealColumn column = meal_column(index);
+    GRect text_bounds = s_meal_title_columns[column];
+    text_bounds.size.h = meals_row_layout(index)->title_height[column];
+    
+    // Set text color: white when highlighted, black otherwise.
+    if(menu_cell_layer_is_highlighted(cell_layer)) {
+      graphics_context_set_text_color(ctx, GColorWhite);
+    } else {
+      graphics_context_set_text_color(ctx, GColorBlack);
+    }
+    
+    // Draw the meal title on up to MEAL_TITLE_MAX_LINES lines.
+    graphics_draw_text(ctx, dict_expand(s_meal_titles[index]), s_meal_title_font, text_bounds,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+    
+    // Draw the subtitle (price) below the title with the regular font.
+    GRect subtitle_bounds = text_bounds;
+    subtitle_bounds.origin.y += text_bounds.size.h + 2;
+    subtitle_bounds.size.h = s_meal_price_line_height;
+    graphics_draw_text(ctx, s_meal_subtitles[index], s_meal_price_font, subtitle_bounds,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+    
+  }
+}
+
+static void meals_menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *context) {
+  int index = meal_slot(meal_index(cell_index));
+  if(index >= 0) {
+    // Open straight from the pushed details when we have them.
+    DetailCacheEntry *entry = detail_cache_find(s_meal_ids[index]);
+    if (entry) {
+      const char *name = entry->strings;
+      const char *price = name + strlen(name) + 1;
+      const uint8_t *notes = (const uint8_t *)price + strlen(price) + 1;
+      show_meal_info_window_separated(name, price, notes, entry->size - (notes - (const uint8_t *)name));
+      return;
+    }
+
+    DictionaryIterator *out_iter;
+    AppMessageResult result = app_message_outbox_begin(&out_iter);
+    if(result == APP_MSG_OK) {
+      // Send the selected meal id back to JS.
+      dict_write_int(out_iter, MESSAGE_KEY_MEAL_ID, &s_meal_ids[index], sizeof(int), true);
+      dict_write_end(out_iter);
+      app_message_outbox_send();
+      diag_request_sent(REQUEST_DETAIL);
+    } else {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "Error sending meal ID: %d", (int)result);
+    }
+  }
+}
+
+static void meal_page_timeout(void *data) {
+  s_page_timer = NULL;
+  s_page_pending = -1;
+}
+
+// Asks the phone for count meals of the current list starting at list index first.
+static void request_meal_page(int first, int count) {
+  if (s_page_pending >= 0 || count <= 0) {
+    return;
+  }
+  DictionaryIterator *out_iter;
+  // Busy, e.g. with the ack of the page that moved the selection; retried from the outbox
+  // sent/failed handlers.
+  s_page_request_pending = app_message_outbox_begin(&out_iter) != APP_MSG_OK;
+  if (s_page_request_pending) {
+    return;
+  }
+  dict_write_uint16(out_iter, MESSAGE_KEY_SELECTED_DAY, s_selected_day);
+  dict_write_uint32(out_iter, MESSAGE_KEY_MEALS_REV, s_meals_rev);
+  dict_write_uint8(out_iter, MESSAGE_KEY_MEALS_PAGE, first);
+  dict_write_uint8(out_iter, MESSAGE_KEY_MEALS_PAGE_COUNT, count);
+  dict_write_end(out_iter);
+  app_message_outbox_send();
+  s_page_pending = first;
+  s_page_timer = app_timer_register(MEALS_PAGE_TIMEOUT_MS, meal_page_timeout, NULL);
+}
+
+// Requests the page around list index when the selection gets close to unloaded rows.
+static void meals_ensure_loaded(int index) {
+  int end = s_meals_first + s_meal_count;
+  if (index < 0 || s_meals_rev == 0) {
+    return;
+  }
+  int page_size = meals_page_size();
+  if (index >= end + page_size || index < s_meals_first - page_size) {
+    // Jumped far away, e.g. to another canteen: load the page of the selected row.
+    int first = index - index % page_size;
+    request_meal_page(first, MIN(page_size, s_meal_total - first));
+  } else if (index + MEALS_PREFETCH_ROWS >= end && end < s_meal_total) {
+    request_meal_page(end, MIN(page_size, s_meal_total - end));
+  } else if (index - MEALS_PREFETCH_ROWS < s_meals_first && s_meals_first > 0) {
+    int first = MAX(0, s_meals_first - page_size);
+    request_meal_page(first, s_meals_first - first);
+  }
+}
+
+// Sends the page request that found the outbox busy, for wherever the selection is now.
+static void meals_retry_page(void) {
+  s_page_request_pending = false;
+  if (s_meals_menu_layer) {
+    MenuIndex selected = menu_layer_get_selected_index(s_meals_menu_layer);
+    meals_ensure_loaded(meal_index(&selected));
+  }
+}
+
+static void meals_menu_selection_changed_callback(MenuLayer *menu_layer, MenuIndex new_index,
+                                                  MenuIndex old_index, void *data) {
+  meals_ensure_loaded(meal_index(&new_index));
+}
+
+// --- Meals window load/unload ---
+static void meals_window_load(Window *window) {
+  Layer *window_layer = window_get_root_layer(window);
+  GRect bounds = layer_get_bounds(window_layer);
+  
+  s_meals_menu_layer = menu_layer_create(bounds);
+  menu_layer_set_callbacks(s_meals_menu_layer, s_meals_menu_layer, (MenuLayerCallbacks){
+    .get_num_sections = meals_menu_get_num_sections_callback,
+    .get_num_rows = meals_menu_get_num_rows_callback,
+    .get_header_height = meals_menu_get_header_height_callback,
+    .draw_header = meals_menu_draw_header_callback,
+    .get_cell_height = meals_menu_get_cell_height_callback,
+    .draw_row = meals_menu_draw_row_callback,
+    .select_click = meals_menu_select_callback,
+    .select_long_click = meals_menu_long_click_callback,
+    .selection_changed = meals_menu_selection_changed_callback,
+  });
+  menu_layer_set_click_config_onto_window(s_meals_menu_layer, window);
+  layer_add_child(window_layer, menu_layer_get_layer(s_meals_menu_layer));
+  s_meals_render_probe_layer = diag_render_probe_create(window_layer);
+  meals_layout_rows(bounds.size.w);
+  state_rendered(SLICE_MEALS);
+}
+
+static void free_meals(void) {
+  meals_layout_invalidate();
+  arena_reset(&s_meal_arena);
+  s_meal_flags_valid = false;
+  s_meal_names_cut = false;
+  for (int i = 0; i < s_meal_count; i++) {
+    s_meal_titles[i] = NULL;
+    s_meal_subtitles[i] = NULL;
+    icon_cache_release(s_meal_bitmaps[i]);
+    s_meal_bitmaps[i] = NULL;
+  }
+  s_meal_count = 0;
+  s_meal_total = 0;
+  s_meals_first = 0;
+  s_page_pending = -1;
+  s_page_request_pending = false;
+  s_section_count = 0;
+  s_meals_rev = 0;
+  s_meals_notice = NULL;
+}
+
+// Puts all meals in one unnamed section, for payloads without canteen sections.
+static void meals_single_section(void) {
+  s_meal_total = s_meal_count;
+  s_section_count = 1;
+  s_section_first[0] = 0;
+  s_section_first[1] = s_meal_count;
+  s_section_names[0] = NULL;
+}
+
+static void meals_window_unload(Window *window) {
+  layer_destroy(s_meals_render_probe_layer);
+  s_meals_render_probe_layer = NULL;
+  menu_layer_destroy(s_meals_menu_layer);
+  s_meals_menu_layer = NULL;
+  // Free meal data and the icons only this window used.
+  free_meals();
+  icon_cache_trim();
+}
+
+static void create_meals_window() {
+  s_meals_window = window_create();
+  window_set_window_handlers(s_meals_window, (WindowHandlers) {
+    .load = meals_window_load,
+    .unload = meals_window_unload
+  });
+}
+
+// Formats the date and weekday labels of every day with the watch's locale.
+static void format_day_labels(void) {
+  arena_reset(&s_day_arena);
+  for (int i = 0; i < s_menu_item_count; i++) {
+    time_t timestamp = (time_t)s_menu_days[i] * SECONDS_PER_DAY;
+    struct tm *date = gmtime(&timestamp);
+    char buffer[24];
+    strftime(buffer, sizeof(buffer), "%d.%m.%Y", date);
+    s_menu_titles[i] = arena_strndup(&s_day_arena, buffer, strlen(buffer));
+    strftime(buffer, sizeof(buffer), "%a", date);
+    s_menu_subtitles[i] = arena_strndup(&s_day_arena, buffer, strlen(buffer));
+  }
+}
+
+// Decodes a DAY_DATA byte array into s_menu_days. Returns false for an unknown version.
+static bool parse_day_data(const uint8_t *data, uint16_t length) {
+  if (length < 2 || data[0] != DAY_DATA_VERSION) {
+    return false;
+  }
+  s_menu_item_count = 0;
+  for (int i = 0; i < data[1] && i < MAX_MENU_ITEMS && 2 + 2 * i + 1 < length; i++) {
+    s_menu_days[i] = data[2 + 2 * i] | (data[3 + 2 * i] << 8);
+    s_menu_item_count++;
+  }
+  format_day_labels();
+  return true;
+}
+
+// Helper: Parse a JSON string array (e.g. ["Foo","Bar",...]) into dst, copying into arena.
+// Returns the number of items parsed.
+static int parse_string_array(const char *json, char **dst, int max_count, Arena *arena) {
+  int count = 0;
+  const char *ptr = json;
+  while (*ptr && count < max_count) {
+    const char *start = strchr(ptr, '\"');
+    if (!start) break;
+    start++;  // move past the opening quote
+    const char *end = strchr(start, '\"');
+    if (!end) break;  // malformed JSON
+    size_t len = end - start;
+    dst[count] = arena_strndup(arena, start, len);
+    if (dst[count]) {
+      count++;
+    }
+    ptr = end + 1;
+  }
+  return count;
+}
+
+// Helper: Parse a JSON numeric array (e.g. [123,456,...]) into dst.
+// Returns the number of items parsed.
+static int parse_int_array(const char *json, int *dst, int max_count) {
+  int count = 0;
+  const char *ptr = json;
+  while (*ptr && count < max_count) {
+    // Skip non-digit characters.
+    while (*ptr && !isdigit((unsigned char)*ptr) && *ptr != '-') {
+      ptr++;
+    }
+    if (!*ptr) break;
+    int value = atoi(ptr);
+    dst[count] = value;
+    count++;
+    // Skip current number.
+    while (*ptr && (isdigit((unsigned char)*ptr) || *ptr == '-')) {
+      ptr++;
+    }
+  }
+  return count;
+}
+
+static void format_price(uint16_t cents, char *buffer, size_t size) {
+  if (cents == MEALS_DATA_NO_PRICE) {
+    snprintf(buffer, size, "N/A");
+  } else {
+    snprintf(buffer, size, "%d.%02d€", cents / 100, cents % 100);
+  }
+}
+
+// Reads the v3 section table: [section count] then per section [meal count:1][name length:1][name].
+// Returns a pointer to the first meal record, or NULL if the table is truncated.
+static const uint8_t *parse_meal_sections(const uint8_t *ptr, const uint8_t *end) {
+  if (ptr >= end) return NULL;
+  int sections = *ptr++;
+  int first = 0;
+  s_section_count = 0;
+  for (int i = 0; i < sections; i++) {
+    if (end - ptr < 2 || end - ptr - 2 < ptr[1]) return NULL;
+    uint8_t meals = ptr[0];
+    uint8_t name_len = ptr[1];
+    // Past MAX_SECTIONS the remaining meals join the last section.
+    if (s_section_count < MAX_SECTIONS) {
+      s_section_first[s_section_count] = first;
+      s_section_names[s_section_count] = name_len ? arena_strndup(&s_meal_arena, (const char *)ptr + 2, name_len) : NULL;
+      s_section_count++;
+    }
+    first += meals;
+    ptr += 2 + name_len;
+  }
+  s_section_first[s_section_count] = first;
+  return ptr;
+}
+
+// Length to store of a meal name; cut at a UTF-8 character boundary under memory pressure.
+static uint8_t meal_name_length(const uint8_t *name, uint8_t length) {
+  if (s_mem_level < MEM_LEVEL_SHORT_NAMES || length <= MEM_SHORT_NAME_BYTES) {
+    return length;
+  }
+  s_meal_names_cut = true;
+  uint8_t cut = MEM_SHORT_NAME_BYTES;
+  while (cut > 0 && (name[cut] & 0xC0) == 0x80) {
+    cut--;
+  }
+  // Do not keep a dictionary reference without its entry byte.
+  if (cut > 0 && name[cut - 1] == DICT_REF) {
+    cut--;
+  }
+  return cut;
+}
+
+// Decodes up to max meal records into the meal arrays from slot on. Returns the number decoded;
+// stops early at the end of the payload or when the meal arena is full.
+static int decode_meal_records(const uint8_t *ptr, const uint8_t *end, int slot, int max, bool has_flags) {
+  int record_size = has_flags ? 8 : 7;
+  int count = 0;
+  while (count < max && end - ptr >= record_size) {
+    int32_t id = (int32_t)(ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24));
+    uint16_t cents = ptr[4] | (ptr[5] << 8);
+    uint8_t flags = has_flags ? ptr[6] : 0;
+    uint8_t name_len = ptr[record_size - 1];
+    ptr += record_size;
+    if (end - ptr < name_len) break;  // truncated payload
+
+    char price_buffer[12];
+    format_price(cents, price_buffer, sizeof(price_buffer));
+    char *name = arena_strndup(&s_meal_arena, (const char *)ptr, meal_name_length(ptr, name_len));
+    char *price = arena_strndup(&s_meal_arena, price_buffer, strlen(price_buffer));
+    if (!name || !price) break;
+    ptr += name_len;
+
+    s_meal_ids[slot + count] = id;
+    s_meal_cents[slot + count] = cents;
+    s_meal_flags[slot + count] = flags;
+    s_meal_titles[slot + count] = name;
+    s_meal_subtitles[slot + count] = price;
+    count++;
+  }
+  return count;
+}
+
+// Decodes a MEALS_DATA byte array in a single pass.
+// Returns the number of meals decoded, or -1 if the payload has an unknown version.
+static int parse_meals_data(const uint8_t *data, uint16_t length) {
+  if (length < MEALS_DATA_HEADER_SIZE || data[0] < MEALS_DATA_VERSION_NO_FLAGS || data[0] > MEALS_DATA_VERSION) {
+    return -1;
+  }
+  bool has_flags = data[0] >= MEALS_DATA_VERSION_NO_SECTIONS;
+  s_meal_flags_valid = has_flags;
+  int total = data[1];
+  const uint8_t *ptr = data + MEALS_DATA_HEADER_SIZE;
+  const uint8_t *end = data + length;
+  s_section_count = 0;
+  if (data[0] == MEALS_DATA_VERSION) {
+    ptr = parse_meal_sections(ptr, end);
+    if (!ptr) {
+      // A cut-off section table would leave sections past the end of the list.
+      s_section_count = 0;
+      return -1;
+    }
+  }
+  int count = decode_meal_records(ptr, end, 0, MIN(total, meals_capacity()), has_flags);
+  // Only v3 lists are paged; older payloads hold every meal they announce.
+  if (data[0] != MEALS_DATA_VERSION) {
+    total = count;
+  }
+  s_meal_total = total;
+  s_meals_first = 0;
+  s_page_pending = -1;
+  if (s_section_count == 0) {
+    s_section_count = 1;
+    s_section_first[0] = 0;
+    s_section_names[0] = NULL;
+  }
+  // Clip the sections to the meals in the list.
+  for (int i = 1; i <= s_section_count; i++) {
+    if (s_section_first[i] > total || i == s_section_count) {
+      s_section_first[i] = total;
+    }
+  }
+  return count;
+}
+
+// Legacy classification for payloads without flags: strips "Vegan"/"Vegetarian" prefixes
+// from the meal names and picks an icon for each meal.
+static void classify_meals_by_name(void) {
+  // Process each meal title.
+  for (int i = 0; i < s_meal_count; i++) {
+    char *name = s_meal_titles[i];
+    // Check for prefix ("Vegan" or "Vegetarian") to remove if present.
+    if ((strncasecmp(name, "vegan", 5) == 0 && (name[5]==' ' || name[5]==':'))) {
+      char *p = name;
+      if (strncasecmp(p, "vegan:", 6)==0) {
+        p += 6;
+      } else {
+        p += 5;
+      }
+      while (*p == ' ' || *p == ':') { p++; }
+      memmove(name, p, strlen(p)+1);
+      s_meal_bitmaps[i] = icon_cache_acquire(ICON_VEGAN);
+    } else if ((strncasecmp(name, "vegetarian", 10) == 0 && (name[10]==' ' || name[10]==':'))) {
+      char *p = name;
+      if (strncasecmp(p, "vegetarian:", 11) == 0) {
+        p += 11;
+      } else {
+        p += 10;
+      }
+      while (*p == ' ' || *p == ':') { p++; }
+      memmove(name, p, strlen(p)+1);
+      s_meal_bitmaps[i] = icon_cache_acquire(ICON_VEGETARIAN);
+    } else if ((strncasecmp(name, "vegetarisch", 11) == 0 && (name[11]==' ' || name[11]==':'))) {
+      char *p = name;
+      if (strncasecmp(p, "vegetarisch:", 12) == 0) {
+        p += 12;
+      } else {
+        p += 11;
+      }
+      while (*p == ' ' || *p == ':') { p++; }
+      memmove(name, p, strlen(p)+1);
+      s_meal_bitmaps[i] = icon_cache_acquire(ICON_VEGETARIAN);
+    } else if (strcasestr(name, "vegan") != NULL) {
+      s_meal_bitmaps[i] = icon_cache_acquire(ICON_VEGAN);
+    } else if (strcasestr(name, "vegetarian") != NULL || strcasestr(name, "vegetarisch") != NULL) {
+      s_meal_bitmaps[i] = icon_cache_acquire(ICON_VEGETARIAN);
+    } else {
+      s_meal_bitmaps[i] = icon_cache_acquire(ICON_POT);
+    }
+  }
+}
+
+static IconType meal_icon(uint8_t flags) {
+  for (size_t j = 0; j < sizeof(s_flag_icons) / sizeof(s_flag_icons[0]); j++) {
+    if (flags & s_flag_icons[j].flag) {
+      return s_flag_icons[j].icon;
+    }
+  }
+  return ICON_POT;
+}
+
+// Picks each meal's icon from its attribute flags.
+static void classify_meals(void) {
+  if (!s_meal_flags_valid) {
+    classify_meals_by_name();
+    return;
+  }
+  for (int i = 0; i < s_meal_count; i++) {
+    s_meal_bitmaps[i] = icon_cache_acquire(meal_icon(s_meal_flags[i]));
+  }
+}
+
+static void meals_view_render(void) {
+  if (s_meals_menu_layer) {
+    diag_render_started(diag_now_ms());
+    meals_layout_rows(layer_get_bounds(menu_layer_get_layer(s_meals_menu_layer)).size.w);
+    menu_layer_reload_data(s_meals_menu_layer);
+  }
+}
+
+// Shows the loaded meals; an open meals window is laid out again with the next state flush.
+static void show_meals_window(void) {
+  if (!s_meals_window) {
+    create_meals_window();
+  }
+  if (!window_stack_contains_window(s_meals_window)) {
+    window_stack_push(s_meals_window, true);
+  } else {
+    state_changed(SLICE_MEALS);
+  }
+}
+
+// --- Persistent cache ---
+// Day list record: [version][count][hash:4 LE] then [day:2 LE] per day; the labels are formatted on load.
+#define DAY_LIST_RECORD_HEADER 6
+static void cache_store_day_list(void) {
+  uint8_t record[DAY_LIST_RECORD_HEADER + 2 * MAX_MENU_ITEMS];
+  record[0] = CACHE_VERSION;
+  record[1] = s_menu_item_count;
+  for (int i = 0; i < 4; i++) {
+    record[2 + i] = (s_days_hash >> (8 * i)) & 0xFF;
+  }
+  for (int i = 0; i < s_menu_item_count; i++) {
+    record[DAY_LIST_RECORD_HEADER + 2 * i] = s_menu_days[i] & 0xFF;
+    record[DAY_LIST_RECORD_HEADER + 1 + 2 * i] = s_menu_days[i] >> 8;
+  }
+  if (persist_write_data(PERSIST_KEY_DAY_LIST, record, DAY_LIST_RECORD_HEADER + 2 * s_menu_item_count) < 0) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Day list not stored");
+  }
+}
+
+static bool cache_load_day_list(void) {
+  uint8_t record[DAY_LIST_RECORD_HEADER + 2 * MAX_MENU_ITEMS];
+  int length = persist_read_data(PERSIST_KEY_DAY_LIST, record, sizeof(record));
+  if (length < DAY_LIST_RECORD_HEADER || record[0] != CACHE_VERSION) {
+    return false;
+  }
+  s_days_hash = record[2] | (record[3] << 8) | (record[4] << 16) | ((uint32_t)record[5] << 24);
+  s_menu_item_count = 0;
+  for (int i = 0; i < record[1] && i < MAX_MENU_ITEMS && DAY_LIST_RECORD_HEADER + 2 * i + 1 < length; i++) {
+    s_menu_days[i] = record[DAY_LIST_RECORD_HEADER + 2 * i] | (record[DAY_LIST_RECORD_HEADER + 1 + 2 * i] << 8);
+    s_menu_item_count++;
+  }
+  format_day_labels();
+  return s_menu_item_count > 0;
+}
+
+static bool cache_read_meal_header(int slot, MealCacheHeader *header) {
+  return persist_read_data(PERSIST_KEY_MEAL_SLOT + slot, header, sizeof(*header)) == (int)sizeof(*header) &&
+         header->version == CACHE_VERSION && header->length <= MEAL_CACHE_MAX_CHUNKS * PERSIST_DATA_MAX_LENGTH;
+}
+
+static void cache_delete_meal_slot(int slot) {
+  persist_delete(PERSIST_KEY_MEAL_SLOT + slot);
+  for (int chunk = 0; chunk < MEAL_CACHE_MAX_CHUNKS; chunk++) {
+    persist_delete(PERSIST_KEY_MEAL_CHUNK + slot * MEAL_CACHE_MAX_CHUNKS + chunk);
+  }
+}
+
+// Stores a MEALS_DATA payload for day, replacing the same day or the least recently stored slot.
+static void cache_store_meals(uint16_t day, const uint8_t *data, uint16_t length, uint32_t rev) {
+  if (day == DAY_NONE || length > MEAL_CACHE_MAX_CHUNKS * PERSIST_DATA_MAX_LENGTH) {
+    return;
+  }
+  int target = -1;
+  int oldest = 0;
+  uint32_t oldest_sequence = UINT32_MAX;
+  uint32_t next_sequence = 1;
+  for (int slot = 0; slot < MEAL_CACHE_SLOTS; slot++) {
+    MealCacheHeader header;
+    if (!cache_read_meal_header(slot, &header)) {
+      if (oldest_sequence > 0) {
+        oldest = slot;
+        oldest_sequence = 0;
+      }
+      continue;
+    }
+    if (header.day == day) {
+      target = slot;
+    }
+    if (header.sequence < oldest_sequence) {
+      oldest = slot;
+      oldest_sequence = header.sequence;
+    }
+    if (header.sequence >= next_sequence) {
+      next_sequence = header.sequence + 1;
+    }
+  }
+  if (target < 0) {
+    target = oldest;
+  }
+
+  // Drop the header first so a partially written slot is never read back, and write it
+  // last, only once every chunk is stored.
+  persist_delete(PERSIST_KEY_MEAL_SLOT + target);
+  for (int chunk = 0; chunk * PERSIST_DATA_MAX_LENGTH < length; chunk++) {
+    int offset = chunk * PERSIST_DATA_MAX_LENGTH;
+    int size = length - offset < PERSIST_DATA_MAX_LENGTH ? length - offset : PERSIST_DATA_MAX_LENGTH;
+    if (persist_write_data(PERSIST_KEY_MEAL_CHUNK + target * MEAL_CACHE_MAX_CHUNKS + chunk, data + offset, size) != size) {
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Meal cache slot %d not stored", target);
+      cache_delete_meal_slot(target);
+      return;
+    }
+  }
+  MealCacheHeader header = { .version = CACHE_VERSION, .day = day, .length = length, .sequence = next_sequence,
+                             .rev = rev, .dict = s_dict.id };
+  if (persist_write_data(PERSIST_KEY_MEAL_SLOT + target, &header, sizeof(header)) != (int)sizeof(header)) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Meal cache slot %d not stored", target);
+    cache_delete_meal_slot(target);
+  }
+}
+
+static bool cache_load_meals(uint16_t day) {
+  for (int slot = 0; slot < MEAL_CACHE_SLOTS; slot++) {
+    MealCacheHeader header;
+    if (!cache_read_meal_header(slot, &header) || header.day != day || header.dict != s_dict.id) {
+      continue;
+    }
+    uint8_t *data = malloc(header.length);
+    if (!data) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "No memory to load %d cached bytes", (int)header.length);
+      governor_step_down();
+      return false;
+    }
+    bool complete = true;
+    for (int chunk = 0; chunk * PERSIST_DATA_MAX_LENGTH < header.length; chunk++) {
+      int offset = chunk * PERSIST_DATA_MAX_LENGTH;
+      int size = header.length - offset < PERSIST_DATA_MAX_LENGTH ? header.length - offset : PERSIST_DATA_MAX_LENGTH;
+      if (persist_read_data(PERSIST_KEY_MEAL_CHUNK + slot * MEAL_CACHE_MAX_CHUNKS + chunk, data + offset, size) != size) {
+        complete = false;
+        break;
+      }
+    }
+    int count = -1;
+    if (complete) {
+      free_meals();
+      count = parse_meals_data(data, header.length);
+      if (count > 0) {
+        s_meal_count = count;
+        s_meals_rev = header.rev;
+        classify_meals();
+      }
+    }
+    free(data);
+    if (count < 0) {
+      // Missing chunks or data we cannot read; drop the slot instead of retrying it every launch.
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Dropping unreadable meal cache slot %d", slot);
+      cache_delete_meal_slot(slot);
+    }
+    return count > 0;
+  }
+  return false;
+}
+
+// --- New: Back button handler for error window ---
+static void error_window_back_handler(ClickRecognizerRef recognizer, void *context) {
+  // Exit the app.
+  window_stack_pop_all(true);
+}
+
+static void error_window_click_config_provider(void *context) {
+  window_single_click_subscribe(BUTTON_ID_BACK, error_window_back_handler);
+}
+
+// --- Updated error window functions ---
+static void error_window_unload(Window *window) {
+  text_layer_destroy(s_error_text_layer);
+  window_destroy(s_error_window);
+  s_error_window = NULL;
+}
+
+static void error_view_render(void) {
+  if (s_error_window) {
+    // Already shown; the text layer displays s_error_text.
+    layer_mark_dirty(text_layer_get_layer(s_error_text_layer));
+    return;
+  }
+  s_error_window = window_create();
+
+#ifdef PBL_ROUND
+  // For round devices like Pebble Time Round, center the text.
+  GRect bounds = layer_get_bounds(window_get_root_layer(s_error_window));
   s_error_text_layer = text_layer_create(GRect(10, bounds.size.h / 2 - 30, bounds.size.w - 20, 60));
   text_layer_set_font(s_error_text_layer, fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD));
 #else
-  s_error_text_layer = text_layer_create(GRect(0, 10, 144, 150));
+  GRect bounds = layer_get_bounds(window_get_root_layer(s_error_window));
+  s_error_text_layer = text_layer_create(GRect(0, 10, bounds.size.w, bounds.size.h - 18));
   text_layer_set_font(s_error_text_layer, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD));
 #endif
   
-  text_layer_set_text(s_error_text_layer, error_msg);
+  text_layer_set_text(s_error_text_layer, s_error_text);
   text_layer_set_text_alignment(s_error_text_layer, GTextAlignmentCenter);
   layer_add_child(window_get_root_layer(s_error_window), text_layer_get_layer(s_error_text_layer));
   
@@ -366,6 +1799,12 @@ static void show_error_window(const char *error_msg) {
   window_stack_push(s_error_window, true);
 }
 
+static void show_error_window(const char *error_msg) {
+  strncpy(s_error_text, error_msg, sizeof(s_error_text) - 1);
+  s_error_text[sizeof(s_error_text) - 1] = '\0';
+  state_changed(SLICE_ERROR);
+}
+
 // Create the meal info window that displays the info on a TextLayer.
 static void meal_info_window_load(Window *window) {
   Layer *window_layer = window_get_root_layer(window);
@@ -440,31 +1879,186 @@ static void meal_info_window_unload(Window *window) {
   s_meal_info_window = NULL;
 }
 
-static void show_meal_info_window_separated(const char *name, const char *price, const char *notes) {
-  // Copy individual fields into our global strings.
-  strncpy(s_meal_info_name, name, sizeof(s_meal_info_name) - 1);
-  s_meal_info_name[sizeof(s_meal_info_name) - 1] = '\0';
-  
-  strncpy(s_meal_info_price, price, sizeof(s_meal_info_price) - 1);
-  s_meal_info_price[sizeof(s_meal_info_price) - 1] = '\0';
-  
-  strncpy(s_meal_info_allergens, notes, sizeof(s_meal_info_allergens) - 1);
-  s_meal_info_allergens[sizeof(s_meal_info_allergens) - 1] = '\0';
-  
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "s_meal_info_name: %s", s_meal_info_name);
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "s_meal_info_price: %s", s_meal_info_price);
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "s_meal_info_allergens: %s", s_meal_info_allergens);
-  
-  s_meal_info_window = window_create();
-  if (!s_meal_info_window) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to create meal info window");
+// Copies src into the detail arena, truncating it to whatever space is left.
+static const char *copy_detail_string(const char *src) {
+  size_t len = strlen(src);
+  size_t available = arena_available(&s_detail_arena);
+  if (available == 0) {
+    return "";
+  }
+  if (len > available - 1) {
+    len = available - 1;
+  }
+  const char *copy = arena_strndup(&s_detail_arena, src, len);
+  return copy ? copy : "";
+}
+
+// Expands coded notes into the detail arena as one line per note. Table strings are read
+// from the NOTE_TABLE resource one at a time, so none of them stay resident. Notes that no
+// longer fit the arena are left out.
+static const char *expand_notes(const uint8_t *notes, uint16_t length) {
+  if (length < 1) {
+    return "";
+  }
+  char *text = s_detail_arena.base + s_detail_arena.used;
+  size_t available = arena_available(&s_detail_arena);
+  if (available == 0) {
+    return "";
+  }
+  size_t used = 0;
+  const uint8_t *ptr = notes + 1;
+  const uint8_t *end = notes + length;
+  ResHandle table = resource_get_handle(RESOURCE_ID_NOTE_TABLE);
+  uint16_t table_count = 0;
+  uint8_t header[2];
+  if (resource_load_byte_range(table, 0, header, sizeof(header)) == sizeof(header)) {
+    table_count = header[0] | (header[1] << 8);
+  }
+  for (int i = 0; i < notes[0] && ptr < end; i++) {
+    uint8_t code = *ptr++;
+    size_t note_len;
+    uint8_t range[4];
+    if (code == NOTE_LITERAL) {
+      if (ptr >= end || end - ptr - 1 < *ptr) break;
+      note_len = *ptr;
+    } else if (code < table_count &&
+               resource_load_byte_range(table, 2 + 2 * code, range, sizeof(range)) == sizeof(range)) {
+      note_len = (range[2] | (range[3] << 8)) - (range[0] | (range[1] << 8));
+    } else {
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Unknown note code %d", code);
+      continue;
+    }
+    size_t separator = used > 0 ? 1 : 0;
+    // Keep room for the terminator.
+    if (used + separator + note_len + 1 > available) {
+      break;
+    }
+    if (separator) {
+      text[used++] = '\n';
+    }
+    if (code == NOTE_LITERAL) {
+      memcpy(text + used, ptr + 1, note_len);
+      ptr += 1 + note_len;
+    } else {
+      resource_load_byte_range(table, range[0] | (range[1] << 8), (uint8_t *)text + used, note_len);
+    }
+    used += note_len;
+  }
+  text[used] = '\0';
+  s_detail_arena.used += used + 1;
+  if (s_detail_arena.used > s_detail_arena.peak) {
+    s_detail_arena.peak = s_detail_arena.used;
+  }
+  return text;
+}
+
+static void show_meal_info_window_separated(const char *name, const char *price,
+                                            const uint8_t *notes, uint16_t notes_len) {
+  // The open window's text layers still point into the detail arena, so close it before reusing it.
+  if (s_meal_info_window) {
+    window_stack_remove(s_meal_info_window, false);
+  }
+
+  // Copy individual fields into the detail arena.
+  arena_reset(&s_detail_arena);
+  s_meal_info_name = copy_detail_string(name);
+  s_meal_info_price = copy_detail_string(price);
+  s_meal_info_allergens = expand_notes(notes, notes_len);
+  
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "s_meal_info_name: %s", s_meal_info_name);
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "s_meal_info_price: %s", s_meal_info_price);
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "s_meal_info_allergens: %s", s_meal_info_allergens);
+  state_changed(SLICE_DETAIL);
+}
+
+static void detail_view_render(void) {
+  if (s_meal_info_window) {
+    window_stack_remove(s_meal_info_window, false);
+  }
+  s_meal_info_window = window_create();
+  if (!s_meal_info_window) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to create meal info window");
+    return;
+  }
+  window_set_window_handlers(s_meal_info_window, (WindowHandlers) {
+    .load = meal_info_window_load,
+    .unload = meal_info_window_unload,
+  });
+  window_stack_push(s_meal_info_window, true);
+}
+
+// --- Diagnostics window ---
+static void diag_window_select_handler(ClickRecognizerRef recognizer, void *context) {
+  // Report the counters to the phone, which logs them.
+  char report[DIAG_REPORT_SIZE];
+  diag_format_report(report, sizeof(report));
+  DictionaryIterator *out_iter;
+  if (app_message_outbox_begin(&out_iter) == APP_MSG_OK) {
+    if (dict_write_cstring(out_iter, MESSAGE_KEY_DIAG_REPORT, report) != DICT_OK) {
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Diagnostics report does not fit the outbox");
+    }
+    dict_write_end(out_iter);
+    app_message_outbox_send();
+  }
+}
+
+static void diag_window_click_config_provider(void *context) {
+  window_single_click_subscribe(BUTTON_ID_SELECT, diag_window_select_handler);
+}
+
+static void diag_window_load(Window *window) {
+  Layer *window_layer = window_get_root_layer(window);
+  GRect bounds = layer_get_bounds(window_layer);
+
+  diag_sample_heap();
+#if DIAG_TEXT_SIZE > DIAG_REPORT_SIZE
+  diag_format(s_diag_text, sizeof(s_diag_text));
+#else
+  diag_format_report(s_diag_text, sizeof(s_diag_text));
+#endif
+
+  s_diag_scroll_layer = scroll_layer_create(bounds);
+  scroll_layer_set_click_config_onto_window(s_diag_scroll_layer, window);
+  scroll_layer_set_callbacks(s_diag_scroll_layer, (ScrollLayerCallbacks) {
+    .click_config_provider = diag_window_click_config_provider,
+  });
+
+  const GFont font = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+  GSize text_size = graphics_text_layout_get_content_size(s_diag_text, font,
+                      GRect(0, 0, bounds.size.w - 4, 2000),
+                      GTextOverflowModeWordWrap, GTextAlignmentLeft);
+  s_diag_text_layer = text_layer_create(GRect(2, 0, bounds.size.w - 4, text_size.h + 10));
+  text_layer_set_font(s_diag_text_layer, font);
+  text_layer_set_overflow_mode(s_diag_text_layer, GTextOverflowModeWordWrap);
+  text_layer_set_text(s_diag_text_layer, s_diag_text);
+  scroll_layer_add_child(s_diag_scroll_layer, text_layer_get_layer(s_diag_text_layer));
+  scroll_layer_set_content_size(s_diag_scroll_layer, GSize(bounds.size.w, text_size.h + 10));
+  layer_add_child(window_layer, scroll_layer_get_layer(s_diag_scroll_layer));
+}
+
+static void diag_window_unload(Window *window) {
+  text_layer_destroy(s_diag_text_layer);
+  s_diag_text_layer = NULL;
+  scroll_layer_destroy(s_diag_scroll_layer);
+  s_diag_scroll_layer = NULL;
+  window_destroy(s_diag_window);
+  s_diag_window = NULL;
+}
+
+static void show_diagnostics_window(void) {
+  if (s_diag_window) {
     return;
   }
-  window_set_window_handlers(s_meal_info_window, (WindowHandlers) {
-    .load = meal_info_window_load,
-    .unload = meal_info_window_unload,
+  s_diag_window = window_create();
+  window_set_window_handlers(s_diag_window, (WindowHandlers) {
+    .load = diag_window_load,
+    .unload = diag_window_unload,
   });
-  window_stack_push(s_meal_info_window, true);
+  window_stack_push(s_diag_window, true);
+}
+
+static void menu_long_click_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
+  show_diagnostics_window();
 }
 
 static void prv_window_load(Window *window) {
@@ -472,53 +2066,137 @@ static void prv_window_load(Window *window) {
   GRect bounds = layer_get_bounds(window_layer);
 
   s_menu_layer = menu_layer_create(bounds);
-  menu_layer_set_callbacks(s_menu_layer, NULL, (MenuLayerCallbacks){
+  menu_layer_set_callbacks(s_menu_layer, s_menu_layer, (MenuLayerCallbacks){
     .get_num_sections = menu_get_num_sections_callback,
     .get_num_rows = menu_get_num_rows_callback,
+    .get_header_height = stale_header_height_callback,
+    .draw_header = stale_header_draw_callback,
     .draw_row = menu_draw_row_callback,
-    .select_click = menu_selection_callback
+    .select_click = menu_selection_callback,
+    .select_long_click = menu_long_click_callback,
   });
   menu_layer_set_click_config_onto_window(s_menu_layer, window);
   layer_add_child(window_layer, menu_layer_get_layer(s_menu_layer));
+  s_render_probe_layer = diag_render_probe_create(window_layer);
+
+  // Render the cached day list until the phone answers.
+  if (s_menu_item_count == 0 && cache_load_day_list()) {
+    s_days_stale = true;
+    diag_reload_menu(s_menu_layer);
+  }
+  state_rendered(SLICE_DAYS);
 }
 
 static void prv_window_unload(Window *window) {
+  layer_destroy(s_render_probe_layer);
+  s_render_probe_layer = NULL;
   menu_layer_destroy(s_menu_layer);
+  s_menu_layer = NULL;
 }
 
-static void reload_app_callback(void *data) {
-  // If an old main window exists, destroy it. also destroy the meals window, meal info window or error window if they exist.
-  if (s_error_window) {
-    window_stack_remove(s_error_window, false);
-    window_destroy(s_error_window);
-    s_error_window = NULL;
+static void days_view_render(void) {
+  if (s_menu_layer) {
+    diag_reload_menu(s_menu_layer);
   }
-  if (s_meals_window) {
-    window_stack_remove(s_meals_window, false);
-    window_destroy(s_meals_window);
-    s_meals_window = NULL;
+}
+
+// --- Pre-warm ---
+// Schedules the next pre-warm for the configured time on the next weekday.
+static void prewarm_schedule(void) {
+  wakeup_cancel_all();
+  if (!persist_exists(PERSIST_KEY_PREWARM_TIME)) {
+    return;
+  }
+  int minutes = persist_read_int(PERSIST_KEY_PREWARM_TIME);
+  time_t next = 0;
+  for (WeekDay day = MONDAY; day <= FRIDAY; day++) {
+    time_t candidate = clock_to_timestamp(day, minutes / 60, minutes % 60);
+    if (next == 0 || candidate < next) {
+      next = candidate;
+    }
+  }
+  WakeupId id = wakeup_schedule(next, 0, false);
+  // E_RANGE means another app's wakeup is within a minute of ours.
+  for (int retry = 1; id == E_RANGE && retry <= PREWARM_RETRY_MINUTES; retry++) {
+    id = wakeup_schedule(next + retry * 60, 0, false);
+  }
+  if (id < 0) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Could not schedule pre-warm: %d", (int)id);
+  }
+}
+
+static void prewarm_finish(void *data) {
+  s_prewarm_timer = NULL;
+  // Popping the last window exits the app.
+  window_stack_pop_all(false);
+}
+
+// Returns whether this pre-warm launch should run, limiting pre-warms to one per PREWARM_MIN_INTERVAL.
+static bool prewarm_begin(void) {
+  time_t now = time(NULL);
+  if (persist_exists(PERSIST_KEY_PREWARM_LAST) &&
+      now - persist_read_int(PERSIST_KEY_PREWARM_LAST) < PREWARM_MIN_INTERVAL) {
+    return false;
+  }
+  persist_write_int(PERSIST_KEY_PREWARM_LAST, now);
+  s_prewarm_timer = app_timer_register(PREWARM_TIMEOUT_MS, prewarm_finish, NULL);
+  return true;
+}
+
+static void prewarm_done(void) {
+  if (s_prewarm_timer) {
+    app_timer_cancel(s_prewarm_timer);
+  }
+  prewarm_finish(NULL);
+}
+
+// A wakeup while the app is open: the user already sees fresh data, just plan the next one.
+static void wakeup_handler(WakeupId id, int32_t cookie) {
+  prewarm_schedule();
+}
+
+// Tells the phone which day list we show, so it can answer DAYS_NOT_MODIFIED.
+static void send_hello(void *data) {
+  DictionaryIterator *out_iter;
+  if (app_message_outbox_begin(&out_iter) != APP_MSG_OK) {
+    return;
   }
+  dict_write_uint32(out_iter, MESSAGE_KEY_DAYS_HASH, s_days_hash);
+  dict_write_uint16(out_iter, MESSAGE_KEY_XFER_CHUNK_SIZE, s_inbox_size - XFER_OVERHEAD);
+  dict_write_end(out_iter);
+  app_message_outbox_send();
+}
+
+// Settings changed: resets the state that depends on them in place and asks the phone again.
+// The day list stays up as stale until the phone answers; meals, details and errors belong to
+// the old settings, so their windows are closed (their unload handlers free the data).
+static void reload_app(void) {
   if (s_meal_info_window) {
     window_stack_remove(s_meal_info_window, false);
-    window_destroy(s_meal_info_window);
-    s_meal_info_window = NULL;
   }
-  if (s_window) {
-    window_stack_remove(s_window, false);
-    window_destroy(s_window);
+  if (s_error_window) {
+    window_stack_remove(s_error_window, false);
   }
-
-  s_window = window_create();
-  window_set_window_handlers(s_window, (WindowHandlers) {
-    .load = prv_window_load,
-    .unload = prv_window_unload,
-  });
-  window_stack_push(s_window, true);
+  s_error_text[0] = '\0';
+  if (s_meals_window && window_stack_contains_window(s_meals_window)) {
+    window_stack_remove(s_meals_window, false);
+  }
+  s_selected_day = DAY_NONE;
+  s_meals_request_pending = false;
+  s_meals_rev = 0;
+  // Prices depend on the price category setting.
+  detail_cache_clear();
+  if (s_menu_item_count > 0) {
+    s_days_stale = true;
+    state_changed(SLICE_DAYS);
+  }
+  diag_request_sent(REQUEST_DAYS);
   // Send a message that the reload is complete.
   DictionaryIterator *out_iter;
   AppMessageResult result = app_message_outbox_begin(&out_iter);
   if(result == APP_MSG_OK) {
     dict_write_int(out_iter, MESSAGE_KEY_RELOAD_DONE, &(int){1}, sizeof(int), true);
+    dict_write_uint32(out_iter, MESSAGE_KEY_DAYS_HASH, s_days_hash);
     dict_write_end(out_iter);
     app_message_outbox_send();
   } else {
@@ -526,24 +2204,618 @@ static void reload_app_callback(void *data) {
   }
 }
 
+static void handle_meals_data(const uint8_t *data, uint16_t length, uint16_t day, uint32_t rev) {
+  governor_check();
+  // Free previous meal data.
+  free_meals();
+  int count = parse_meals_data(data, length);
+  if (count < 0) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Unsupported or corrupt meals data (version %d)", (int)data[0]);
+    return;
+  }
+  if (count < s_meal_total) {
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Loaded %d of %d meals", count, s_meal_total);
+  }
+  s_meals_rev = rev;
+  cache_store_meals(day, data, length, rev);
+  diag_response_received(REQUEST_MEALS);
+  if (s_prewarm) {
+    // Stored for the next launch; nothing to show.
+    free_meals();
+    prewarm_done();
+    return;
+  }
+  s_meal_count = count;
+  s_meals_stale = false;
+  classify_meals();
+  show_meals_window();
+}
+
+// The phone confirmed that the meals shown for day (cached, revision rev) are current.
+static void handle_meals_not_modified(uint16_t day, uint32_t rev) {
+  if (day == DAY_NONE || day != s_selected_day) {
+    return;  // Answer to an earlier selection.
+  }
+  if (rev == 0 || rev != s_meals_rev) {
+    // Other meals were loaded meanwhile; ask again with what we hold now.
+    request_meals(day);
+    return;
+  }
+  diag_response_received(REQUEST_MEALS);
+  if (s_prewarm) {
+    free_meals();
+    prewarm_done();
+    return;
+  }
+  if (s_meals_stale) {
+    // Dropping the "Updating..." header moves the rows.
+    s_meals_stale = false;
+    state_changed(SLICE_MEALS);
+  }
+}
+
+// The phone has no meals for day. A list that is already shown stays, marked as not updated;
+// otherwise the meals window opens empty with the reason in its header.
+static void handle_meals_unavailable(uint16_t day, uint8_t reason) {
+  if (day == DAY_NONE || day != s_selected_day) {
+    return;  // Answer to an earlier selection.
+  }
+  diag_response_received(REQUEST_MEALS);
+  if (s_prewarm) {
+    free_meals();
+    prewarm_done();
+    return;
+  }
+  bool keep = reason == MEALS_UNAVAILABLE_FAILED && s_meal_count > 0;
+  if (!keep) {
+    free_meals();
+  }
+  s_meals_stale = false;
+  s_meals_notice = reason == MEALS_UNAVAILABLE_NONE ? "No meals served" :
+                   keep ? "Not updated" : "Could not load meals";
+  show_meals_window();
+}
+
+// --- Meal list deltas ---
+static int meals_find(int32_t id) {
+  for (int i = 0; i < s_meal_count; i++) {
+    if (s_meal_ids[i] == id) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Moves count meals from src to dst in all meal arrays.
+static void meals_move(int dst, int src, int count) {
+  memmove(&s_meal_ids[dst], &s_meal_ids[src], count * sizeof(s_meal_ids[0]));
+  memmove(&s_meal_titles[dst], &s_meal_titles[src], count * sizeof(s_meal_titles[0]));
+  memmove(&s_meal_subtitles[dst], &s_meal_subtitles[src], count * sizeof(s_meal_subtitles[0]));
+  memmove(&s_meal_bitmaps[dst], &s_meal_bitmaps[src], count * sizeof(s_meal_bitmaps[0]));
+  memmove(&s_meal_cents[dst], &s_meal_cents[src], count * sizeof(s_meal_cents[0]));
+  memmove(&s_meal_flags[dst], &s_meal_flags[src], count * sizeof(s_meal_flags[0]));
+  memmove(&s_meal_rows[dst], &s_meal_rows[src], count * sizeof(s_meal_rows[0]));
+}
+
+static void meals_remove_at(int index) {
+  icon_cache_release(s_meal_bitmaps[index]);
+  meals_move(index, index + 1, s_meal_count - index - 1);
+  s_meal_count--;
+  s_meal_total--;
+  for (int i = 1; i <= s_section_count; i++) {
+    if (s_section_first[i] > index) {
+      s_section_first[i]--;
+    }
+  }
+}
+
+// Applies the ops of a delta to the loaded meals. Strings of changed meals are appended to the
+// meal arena; the old ones stay until the next full list resets it. Returns false when the delta
+// cannot be applied and a full list is needed. *relayout is set when row positions or heights change.
+static bool apply_meals_delta(const uint8_t *data, uint16_t length, bool *relayout) {
+  const uint8_t *ptr = data + MEALS_DELTA_HEADER_SIZE;
+  const uint8_t *end = data + length;
+  char price_buffer[12];
+  for (int op = 0; op < data[5]; op++) {
+    if (end - ptr < 5) return false;
+    uint8_t type = *ptr++;
+    if (type == DELTA_OP_ADD) {
+      if (end - ptr < 10 || end - ptr - 10 < ptr[9]) return false;
+      uint8_t section = ptr[0];
+      if (section >= s_section_count || s_meal_count >= meals_capacity()) return false;
+      int index = s_section_first[section] + ptr[1];
+      if (index > s_section_first[section + 1]) {
+        index = s_section_first[section + 1];
+      }
+      const uint8_t *record = ptr + 2;
+      uint16_t cents = record[4] | (record[5] << 8);
+      format_price(cents, price_buffer, sizeof(price_buffer));
+      char *name = arena_strndup(&s_meal_arena, (const char *)record + 8, meal_name_length(record + 8, record[7]));
+      char *price = arena_strndup(&s_meal_arena, price_buffer, strlen(price_buffer));
+      if (!name || !price) return false;
+      meals_move(index + 1, index, s_meal_count - index);
+      s_meal_count++;
+      s_meal_total++;
+      for (int i = section + 1; i <= s_section_count; i++) {
+        s_section_first[i]++;
+      }
+      s_meal_ids[index] = (int32_t)(record[0] | (record[1] << 8) | (record[2] << 16) | ((uint32_t)record[3] << 24));
+      s_meal_cents[index] = cents;
+      s_meal_flags[index] = record[6];
+      s_meal_titles[index] = name;
+      s_meal_subtitles[index] = price;
+      s_meal_bitmaps[index] = icon_cache_acquire(meal_icon(record[6]));
+      meals_measure_row(index);
+      *relayout = true;
+      ptr = record + 8 + record[7];
+      continue;
+    }
+
+    int32_t id = (int32_t)(ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24));
+    ptr += 4;
+    int index = meals_find(id);
+    if (type == DELTA_OP_REMOVE) {
+      if (index >= 0) {
+        meals_remove_at(index);
+        *relayout = true;
+      }
+      continue;
+    }
+    if (type != DELTA_OP_CHANGE || index < 0 || ptr >= end) return false;
+    uint8_t fields = *ptr++;
+    if (fields & DELTA_FIELD_PRICE) {
+      if (end - ptr < 2) return false;
+      s_meal_cents[index] = ptr[0] | (ptr[1] << 8);
+      format_price(s_meal_cents[index], price_buffer, sizeof(price_buffer));
+      s_meal_subtitles[index] = arena_strndup(&s_meal_arena, price_buffer, strlen(price_buffer));
+      if (!s_meal_subtitles[index]) return false;
+      ptr += 2;
+    }
+    if (fields & DELTA_FIELD_FLAGS) {
+      if (end - ptr < 1) return false;
+      MealColumn column = meal_column(index);
+      s_meal_flags[index] = *ptr++;
+      icon_cache_release(s_meal_bitmaps[index]);
+      s_meal_bitmaps[index] = icon_cache_acquire(meal_icon(s_meal_flags[index]));
+      if (meal_column(index) != column) {
+        *relayout = true;
+      }
+    }
+    if (fields & DELTA_FIELD_NAME) {
+      if (end - ptr < 1 || end - ptr - 1 < ptr[0]) return false;
+      s_meal_titles[index] = arena_strndup(&s_meal_arena, (const char *)ptr + 1, meal_name_length(ptr + 1, ptr[0]));
+      if (!s_meal_titles[index]) return false;
+      ptr += 1 + ptr[0];
+    }
+    if (meals_measure_row(index)) {
+      *relayout = true;
+    }
+  }
+  return true;
+}
+
+// Re-encodes the loaded meals as MEALS_DATA so the persistent cache follows applied deltas.
+static void cache_store_loaded_meals(uint16_t day) {
+  size_t length = MEALS_DATA_HEADER_SIZE + 1;
+  for (int i = 0; i < s_section_count; i++) {
+    length += 2 + (s_section_names[i] ? strlen(s_section_names[i]) : 0);
+  }
+  for (int i = 0; i < s_meal_count; i++) {
+    length += 8 + strlen(s_meal_titles[i]);
+  }
+  if (length > MEAL_CACHE_MAX_CHUNKS * PERSIST_DATA_MAX_LENGTH) {
+    return;
+  }
+  uint8_t *data = malloc(length);
+  if (!data) {
+    return;
+  }
+  uint8_t *ptr = data;
+  *ptr++ = MEALS_DATA_VERSION;
+  *ptr++ = s_meal_count;
+  *ptr++ = s_section_count;
+  for (int i = 0; i < s_section_count; i++) {
+    size_t name_len = s_section_names[i] ? strlen(s_section_names[i]) : 0;
+    *ptr++ = s_section_first[i + 1] - s_section_first[i];
+    *ptr++ = name_len;
+    memcpy(ptr, s_section_names[i], name_len);
+    ptr += name_len;
+  }
+  for (int i = 0; i < s_meal_count; i++) {
+    size_t name_len = strlen(s_meal_titles[i]);
+    uint32_t id = (uint32_t)s_meal_ids[i];
+    *ptr++ = id;
+    *ptr++ = id >> 8;
+    *ptr++ = id >> 16;
+    *ptr++ = id >> 24;
+    *ptr++ = s_meal_cents[i];
+    *ptr++ = s_meal_cents[i] >> 8;
+    *ptr++ = s_meal_flags[i];
+    *ptr++ = name_len;
+    memcpy(ptr, s_meal_titles[i], name_len);
+    ptr += name_len;
+  }
+  cache_store_meals(day, data, length, s_meals_rev);
+  free(data);
+}
+
+static void handle_meals_delta(const uint8_t *data, uint16_t length, uint16_t day, uint32_t rev) {
+  // Deltas only update the list on screen; a closed meals window just misses them.
+  if (day != s_selected_day || !s_meals_menu_layer || s_section_count == 0) {
+    return;
+  }
+  // Deltas address the whole list, so a paged list is replaced instead.
+  bool complete = s_meals_first == 0 && s_meal_count == s_meal_total;
+  uint32_t base = length >= MEALS_DELTA_HEADER_SIZE ?
+                    (uint32_t)(data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t)data[4] << 24)) : 0;
+  if (length < MEALS_DELTA_HEADER_SIZE || data[0] != MEALS_DELTA_VERSION || base == 0 || base != s_meals_rev ||
+      !complete) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Delta does not match the loaded meals; requesting the full list");
+    s_meals_rev = 0;
+    request_meals(day);
+    return;
+  }
+
+  // Remember the selected meal so the selection stays on it when rows move.
+  MenuIndex selected = menu_layer_get_selected_index(s_meals_menu_layer);
+  int selected_meal = meal_index(&selected);
+  int32_t selected_id = selected_meal >= 0 ? s_meal_ids[selected_meal] : 0;
+
+  diag_render_started(diag_now_ms());
+  bool relayout = s_meals_stale;  // Dropping the "Updating..." header moves the rows too.
+  if (!apply_meals_delta(data, length, &relayout)) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Could not apply delta; requesting the full list");
+    s_meals_rev = 0;
+    request_meals(day);
+    return;
+  }
+  s_meals_rev = rev;
+  s_meals_stale = false;
+  diag_response_received(REQUEST_MEALS);
+
+  if (relayout) {
+    menu_layer_reload_data(s_meals_menu_layer);
+    meals_select_index(selected_meal >= 0 ? meals_find(selected_id) : -1);
+  } else {
+    // Same rows and heights: redraw in place.
+    layer_mark_dirty(menu_layer_get_layer(s_meals_menu_layer));
+  }
+  // Cut names would be filed under the full revision; the cached older revision still
+  // takes the next delta.
+  if (!s_meal_names_cut) {
+    cache_store_loaded_meals(day);
+  }
+}
+
+// Drops count loaded meals from the front or the back of the arrays.
+static void meals_evict(int count, bool front) {
+  int first = front ? 0 : s_meal_count - count;
+  for (int i = first; i < first + count; i++) {
+    icon_cache_release(s_meal_bitmaps[i]);
+  }
+  if (front) {
+    meals_move(0, count, s_meal_count - count);
+    s_meals_first += count;
+  }
+  s_meal_count -= count;
+}
+
+// Copies the strings still referenced into a fresh meal arena, reclaiming evicted rows.
+static void meals_compact_arena(void) {
+  size_t used = s_meal_arena.used;
+  char *copy = malloc(used);
+  if (!copy) {
+    return;
+  }
+  memcpy(copy, s_meal_arena.base, used);
+  arena_reset(&s_meal_arena);
+  for (int i = 0; i < s_section_count; i++) {
+    if (s_section_names[i]) {
+      const char *old = copy + (s_section_names[i] - s_meal_arena.base);
+      s_section_names[i] = arena_strndup(&s_meal_arena, old, strlen(old));
+    }
+  }
+  for (int i = 0; i < s_meal_count; i++) {
+    const char *title = copy + (s_meal_titles[i] - s_meal_arena.base);
+    const char *price = copy + (s_meal_subtitles[i] - s_meal_arena.base);
+    s_meal_titles[i] = arena_strndup(&s_meal_arena, title, strlen(title));
+    s_meal_subtitles[i] = arena_strndup(&s_meal_arena, price, strlen(price));
+  }
+  free(copy);
+}
+
+static void handle_meals_page(const uint8_t *data, uint16_t length, uint16_t day) {
+  if (s_page_timer) {
+    app_timer_cancel(s_page_timer);
+    s_page_timer = NULL;
+  }
+  s_page_pending = -1;
+  if (length < MEALS_PAGE_HEADER_SIZE || data[0] != MEALS_PAGE_VERSION || !s_meals_menu_layer) {
+    return;
+  }
+  uint32_t rev = (uint32_t)(data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t)data[4] << 24));
+  governor_check();
+  int first = data[5];
+  int count = MIN(data[6], meals_capacity());
+  if (day != s_selected_day || rev != s_meals_rev || first + count > s_meal_total) {
+    return;
+  }
+
+  // Keep the loaded meals contiguous: extend them at either end, evicting rows from the other
+  // end when the arrays are full, or start over for a page elsewhere in the list.
+  int end = s_meals_first + s_meal_count;
+  bool append = first == end;
+  bool prepend = first + count == s_meals_first;
+  int overflow = s_meal_count + count - meals_capacity();
+  if (!append && !prepend) {
+    meals_evict(s_meal_count, false);
+    s_meals_first = first;
+    append = true;
+  } else if (overflow > 0) {
+    meals_evict(overflow, append);
+  }
+  meals_compact_arena();
+
+  int slot = s_meal_count;
+  if (prepend) {
+    meals_move(count, 0, s_meal_count);
+    slot = 0;
+  }
+  int decoded = decode_meal_records(data + MEALS_PAGE_HEADER_SIZE, data + length, slot, count, true);
+  if (prepend && decoded < count) {
+    // Keep the arrays contiguous if the arena ran out.
+    meals_move(decoded, count, s_meal_count);
+  }
+  for (int i = slot; i < slot + decoded; i++) {
+    s_meal_bitmaps[i] = icon_cache_acquire(meal_icon(s_meal_flags[i]));
+    meals_measure_row(i);
+  }
+  s_meal_count += decoded;
+  if (prepend) {
+    s_meals_first -= decoded;
+  }
+
+  MenuIndex selected = menu_layer_get_selected_index(s_meals_menu_layer);
+  diag_render_started(diag_now_ms());
+  menu_layer_reload_data(s_meals_menu_layer);
+  meals_select_index(meal_index(&selected));
+  // The selection may have moved on while the page was in flight.
+  meals_ensure_loaded(meal_index(&selected));
+}
+
+// --- Memory-pressure governor ---
+static void governor_report(void) {
+  DictionaryIterator *out_iter;
+  if (app_message_outbox_begin(&out_iter) != APP_MSG_OK) {
+    // Outbox busy; retried from the outbox sent/failed handlers.
+    s_mem_report_pending = true;
+    return;
+  }
+  s_mem_report_pending = false;
+  dict_write_uint8(out_iter, MESSAGE_KEY_MEM_LEVEL, s_mem_level);
+  dict_write_end(out_iter);
+  app_message_outbox_send();
+}
+
+static void governor_apply(MemLevel level) {
+  MemLevel old = s_mem_level;
+  APP_LOG(APP_LOG_LEVEL_WARNING, "Memory level %d -> %d (%d bytes free)", (int)old, (int)level, (int)heap_bytes_free());
+  s_mem_level = level;
+  if (level >= MEM_LEVEL_NO_ICONS && old < MEM_LEVEL_NO_ICONS) {
+    for (int i = 0; i < s_meal_count; i++) {
+      icon_cache_release(s_meal_bitmaps[i]);
+      s_meal_bitmaps[i] = NULL;
+    }
+    icon_cache_trim();
+  } else if (level < MEM_LEVEL_NO_ICONS && old >= MEM_LEVEL_NO_ICONS && s_meal_flags_valid) {
+    for (int i = 0; i < s_meal_count; i++) {
+      s_meal_bitmaps[i] = icon_cache_acquire(meal_icon(s_meal_flags[i]));
+    }
+  }
+  if (level >= MEM_LEVEL_SHORT_NAMES && old < MEM_LEVEL_SHORT_NAMES) {
+    detail_cache_clear();
+  }
+  if (s_meal_count > meals_capacity()) {
+    meals_evict(s_meal_count - meals_capacity(), false);
+    meals_compact_arena();
+  }
+  state_changed(SLICE_MEALS);
+  // The phone sends smaller pages and skips the detail push at the higher levels.
+  governor_report();
+}
+
+static void governor_check(void) {
+  size_t free_bytes = heap_bytes_free();
+  MemLevel level = MEM_LEVEL_NORMAL;
+  for (int i = MEM_LEVEL_NO_ICONS; i <= MEM_LEVEL_FEW_ROWS; i++) {
+    size_t threshold = s_mem_thresholds[i] + (i <= (int)s_mem_level ? MEM_HYSTERESIS : 0);
+    if (free_bytes < threshold) {
+      level = i;
+    }
+  }
+  if (level != s_mem_level) {
+    governor_apply(level);
+  }
+}
+
+// An allocation failed despite the thresholds, e.g. from fragmentation: go one level down.
+static void governor_step_down(void) {
+  if (s_mem_level < MEM_LEVEL_FEW_ROWS) {
+    governor_apply(s_mem_level + 1);
+  }
+}
+
+// --- Chunked transfer ---
+static void xfer_send_reply(void) {
+  DictionaryIterator *out_iter;
+  if (app_message_outbox_begin(&out_iter) != APP_MSG_OK) {
+    // Outbox busy; retried from the outbox sent/failed handlers.
+    s_xfer_reply_pending = true;
+    return;
+  }
+  s_xfer_reply_pending = false;
+  dict_write_uint8(out_iter, MESSAGE_KEY_XFER_ID, s_transfer.id);
+  dict_write_uint8(out_iter, s_xfer_reply_is_nack ? MESSAGE_KEY_XFER_NACK : MESSAGE_KEY_XFER_ACK, s_transfer.next_seq);
+  dict_write_end(out_iter);
+  app_message_outbox_send();
+}
+
+static void xfer_reply(bool nack) {
+  s_xfer_reply_is_nack = nack;
+  xfer_send_reply();
+}
+
+static void xfer_reset(void) {
+  free(s_transfer.buffer);
+  s_transfer = (Transfer){ 0 };
+}
+
+static void xfer_receive_chunk(DictionaryIterator *iterator, Tuple *data_tuple) {
+  Tuple *id_tuple = dict_find(iterator, MESSAGE_KEY_XFER_ID);
+  Tuple *seq_tuple = dict_find(iterator, MESSAGE_KEY_XFER_SEQ);
+  Tuple *offset_tuple = dict_find(iterator, MESSAGE_KEY_XFER_OFFSET);
+  Tuple *total_tuple = dict_find(iterator, MESSAGE_KEY_XFER_TOTAL);
+  Tuple *kind_tuple = dict_find(iterator, MESSAGE_KEY_XFER_KIND);
+  if (!id_tuple || !seq_tuple || !offset_tuple || !total_tuple || !kind_tuple) {
+    return;
+  }
+  uint8_t id = id_tuple->value->uint8;
+  uint8_t seq = seq_tuple->value->uint8;
+  uint32_t offset = offset_tuple->value->uint32;
+  uint32_t total = total_tuple->value->uint32;
+
+  uint8_t kind = kind_tuple->value->uint8;
+
+  // The phone numbers its transfers anew when it restarts, so a first chunk with a known id
+  // but another kind or size starts a new transfer as well.
+  if (seq == 0 && (id != s_transfer.id || kind != s_transfer.kind || total != s_transfer.total)) {
+    // A new transfer replaces whatever was in progress.
+    xfer_reset();
+    governor_check();
+    if (total == 0 || total > XFER_MAX_SIZE) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "Transfer too large: %d bytes", (int)total);
+      return;
+    }
+    s_transfer.buffer = malloc(total);
+    if (!s_transfer.buffer) {
+      // Not acknowledged, so the phone sends the transfer again after its timeout.
+      APP_LOG(APP_LOG_LEVEL_ERROR, "No memory for a %d byte transfer", (int)total);
+      governor_step_down();
+      return;
+    }
+    s_transfer.id = id;
+    s_transfer.kind = kind;
+    s_transfer.total = total;
+    Tuple *day_tuple = dict_find(iterator, MESSAGE_KEY_SELECTED_DAY);
+    s_transfer.day = day_tuple ? day_tuple->value->uint16 : s_selected_day;
+    Tuple *rev_tuple = dict_find(iterator, MESSAGE_KEY_MEALS_REV);
+    s_transfer.rev = rev_tuple ? rev_tuple->value->uint32 : 0;
+  } else if (id != s_transfer.id) {
+    // Chunk of a transfer we never started.
+    return;
+  } else if (!s_transfer.buffer) {
+    xfer_reply(false);  // Already complete; repeat the final ack.
+    return;
+  }
+
+  if (seq < s_transfer.next_seq) {
+    xfer_reply(false);  // Duplicate; repeat the ack.
+    return;
+  }
+  if (seq > s_transfer.next_seq || offset != s_transfer.received ||
+      offset + data_tuple->length > s_transfer.total) {
+    xfer_reply(true);   // Gap; ask for the chunk we expect.
+    return;
+  }
+
+  memcpy(s_transfer.buffer + offset, data_tuple->value->data, data_tuple->length);
+  s_transfer.received += data_tuple->length;
+  s_transfer.next_seq++;
+  xfer_reply(false);
+
+  if (s_transfer.received == s_transfer.total) {
+    if (s_transfer.kind == XFER_KIND_MEALS) {
+      handle_meals_data(s_transfer.buffer, s_transfer.total, s_transfer.day, s_transfer.rev);
+    } else if (s_transfer.kind == XFER_KIND_MEALS_PAGE) {
+      handle_meals_page(s_transfer.buffer, s_transfer.total, s_transfer.day);
+    } else if (s_transfer.kind == XFER_KIND_MEALS_DELTA) {
+      handle_meals_delta(s_transfer.buffer, s_transfer.total, s_transfer.day, s_transfer.rev);
+    } else if (s_transfer.kind == XFER_KIND_DETAILS) {
+      parse_details_data(s_transfer.buffer, s_transfer.total);
+    } else if (s_transfer.kind == XFER_KIND_DICT) {
+      handle_dict_data(s_transfer.buffer, s_transfer.total);
+    }
+    // Keep the id so late duplicates are still acknowledged.
+    free(s_transfer.buffer);
+    s_transfer.buffer = NULL;
+  }
+}
+
+static void outbox_sent_callback(DictionaryIterator *iterator, void *context) {
+  if (s_xfer_reply_pending) {
+    xfer_send_reply();
+  } else if (s_mem_report_pending) {
+    governor_report();
+  } else if (s_meals_request_pending) {
+    request_meals(s_selected_day);
+  } else if (s_page_request_pending) {
+    meals_retry_page();
+  }
+}
+
+static void outbox_failed_callback(DictionaryIterator *iterator, AppMessageResult reason, void *context) {
+  APP_LOG(APP_LOG_LEVEL_ERROR, "Message send failed. Reason: %d", (int)reason);
+  s_diag.send_failed++;
+  s_diag.last_send_failure = reason;
+  if (s_xfer_reply_pending) {
+    xfer_send_reply();
+  } else if (s_mem_report_pending) {
+    governor_report();
+  } else if (s_meals_request_pending) {
+    request_meals(s_selected_day);
+  } else if (s_page_request_pending) {
+    meals_retry_page();
+  } else if (dict_find(iterator, MESSAGE_KEY_DAYS_HASH) && !dict_find(iterator, MESSAGE_KEY_RELOAD_DONE) &&
+             s_hello_retries++ < HELLO_RETRIES) {
+    app_timer_register(HELLO_RETRY_MS, send_hello, NULL);
+  }
+}
+
 static void inbox_received_callback(DictionaryIterator *iterator, void *context) {
 
   Tuple *reload_tuple = dict_find(iterator, MESSAGE_KEY_RELOAD_APP);
   if (reload_tuple) {
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "Reload message received; restarting app");
-    app_timer_register(100, reload_app_callback, NULL);
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Reload message received; resetting app state");
+    reload_app();
     return;
   }
 
   // Check for an error message first.
   Tuple *error_tuple = dict_find(iterator, MESSAGE_KEY_ERROR_MSG);
   if (error_tuple) {
-    show_error_window(error_tuple->value->cstring);
+    if (s_prewarm) {
+      prewarm_done();
+    } else {
+      show_error_window(error_tuple->value->cstring);
+    }
     return;
   }
+
+  // Clay also sends the raw "HH:MM" setting under this key; only the phone's minutes count.
+  Tuple *prewarm_tuple = dict_find(iterator, MESSAGE_KEY_PREWARM_TIME);
+  if (prewarm_tuple && (prewarm_tuple->type == TUPLE_INT || prewarm_tuple->type == TUPLE_UINT)) {
+    int32_t minutes = prewarm_tuple->value->int32;
+    if (minutes >= 0 && minutes < 24 * 60) {
+      persist_write_int(PERSIST_KEY_PREWARM_TIME, minutes);
+    } else {
+      persist_delete(PERSIST_KEY_PREWARM_TIME);
+    }
+    prewarm_schedule();
+  }
   
-  Tuple *day_list_tuple = dict_find(iterator, MESSAGE_KEY_DAY_LIST);
-  Tuple *weekday_list_tuple = dict_find(iterator, MESSAGE_KEY_WEEKDAY_LIST);
+  Tuple *day_data_tuple = dict_find(iterator, MESSAGE_KEY_DAY_DATA);
+  Tuple *meals_data_tuple = dict_find(iterator, MESSAGE_KEY_MEALS_DATA);
+  Tuple *xfer_data_tuple = dict_find(iterator, MESSAGE_KEY_XFER_DATA);
   Tuple *meals_ids_tuple = dict_find(iterator, MESSAGE_KEY_MEALS_IDS);
   Tuple *meals_names_tuple = dict_find(iterator, MESSAGE_KEY_MEALS_NAMES);
   Tuple *meals_prices_tuple = dict_find(iterator, MESSAGE_KEY_MEALS_PRICES);
@@ -552,127 +2824,152 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
   Tuple *meal_notes_tuple = dict_find(iterator, MESSAGE_KEY_MEAL_NOTES);
   
   // Use separate field messages if available.
-  if (meal_name_tuple && meal_price_tuple && meal_notes_tuple) {
+  if (meal_name_tuple && meal_price_tuple && meal_notes_tuple && meal_notes_tuple->type == TUPLE_BYTE_ARRAY) {
     APP_LOG(APP_LOG_LEVEL_DEBUG, "Showing meal info window");
+    diag_response_received(REQUEST_DETAIL);
     show_meal_info_window_separated(meal_name_tuple->value->cstring,
                                     meal_price_tuple->value->cstring,
-                                    meal_notes_tuple->value->cstring);
+                                    meal_notes_tuple->value->data, meal_notes_tuple->length);
   }
 
-  if (day_list_tuple) {
-    // Free old day titles.
-    for (int i = 0; i < s_menu_item_count; i++) {
-      free(s_menu_titles[i]);
+  bool days_current = false;
+  if (day_data_tuple && day_data_tuple->type == TUPLE_BYTE_ARRAY) {
+    // Resets the day arena, dropping the old titles and subtitles.
+    if (parse_day_data(day_data_tuple->value->data, day_data_tuple->length)) {
+      Tuple *hash_tuple = dict_find(iterator, MESSAGE_KEY_DAYS_HASH);
+      s_days_hash = hash_tuple ? hash_tuple->value->uint32 : 0;
+      cache_store_day_list();
+      days_current = true;
+      state_changed(SLICE_DAYS);
+    } else {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "Unsupported day data version: %d", (int)day_data_tuple->value->data[0]);
     }
-    parse_day_list(day_list_tuple->value->cstring);
-  }
-  
-  if (weekday_list_tuple) {
-    for (int i = 0; i < s_menu_item_count; i++) {
-      free(s_menu_subtitles[i]);
+  } else if (dict_find(iterator, MESSAGE_KEY_DAYS_NOT_MODIFIED) && s_menu_item_count > 0) {
+    days_current = true;
+    if (s_days_stale) {
+      // Dropping the "Updating..." header moves the rows.
+      s_days_stale = false;
+      state_changed(SLICE_DAYS);
     }
-    parse_weekday_list(weekday_list_tuple->value->cstring);
   }
-  
-  if (meals_ids_tuple && meals_names_tuple && meals_prices_tuple) {
-    // Free previous meal data.
-    for (int i = 0; i < s_meal_count; i++) {
-      free(s_meal_titles[i]);
-      free(s_meal_subtitles[i]);
-      if (s_meal_bitmaps[i]) {
-        gbitmap_destroy(s_meal_bitmaps[i]);
-        s_meal_bitmaps[i] = NULL;
+  if (days_current) {
+    diag_response_received(REQUEST_DAYS);
+    s_days_stale = false;
+    // Pre-warm the nearest open day; the phone only lists days from today on.
+    if (s_prewarm && s_selected_day == DAY_NONE) {
+      if (s_menu_item_count > 0) {
+        request_meals(s_menu_days[0]);
+      } else {
+        prewarm_done();
       }
     }
+  }
+
+  if (dict_find(iterator, MESSAGE_KEY_MEALS_NOT_MODIFIED)) {
+    Tuple *day_tuple = dict_find(iterator, MESSAGE_KEY_SELECTED_DAY);
+    Tuple *rev_tuple = dict_find(iterator, MESSAGE_KEY_MEALS_REV);
+    handle_meals_not_modified(day_tuple ? day_tuple->value->uint16 : DAY_NONE, rev_tuple ? rev_tuple->value->uint32 : 0);
+  }
+
+  Tuple *unavailable_tuple = dict_find(iterator, MESSAGE_KEY_MEALS_UNAVAILABLE);
+  if (unavailable_tuple) {
+    Tuple *day_tuple = dict_find(iterator, MESSAGE_KEY_SELECTED_DAY);
+    handle_meals_unavailable(day_tuple ? day_tuple->value->uint16 : DAY_NONE, unavailable_tuple->value->uint8);
+  }
+  
+  if (xfer_data_tuple) {
+    xfer_receive_chunk(iterator, xfer_data_tuple);
+  }
+
+  if (meals_data_tuple && meals_data_tuple->type == TUPLE_BYTE_ARRAY) {
+    Tuple *day_tuple = dict_find(iterator, MESSAGE_KEY_SELECTED_DAY);
+    Tuple *rev_tuple = dict_find(iterator, MESSAGE_KEY_MEALS_REV);
+    handle_meals_data(meals_data_tuple->value->data, meals_data_tuple->length,
+                      day_tuple ? day_tuple->value->uint16 : s_selected_day,
+                      rev_tuple ? rev_tuple->value->uint32 : 0);
+  } else if (meals_ids_tuple && meals_names_tuple && meals_prices_tuple) {
+    // Fallback for the older JSON encoded arrays.
+    free_meals();
     int count_ids = parse_int_array(meals_ids_tuple->value->cstring, s_meal_ids, MAX_MEALS);
-    int count_names = parse_string_array(meals_names_tuple->value->cstring, s_meal_titles, MAX_MEALS);
-    int count_prices = parse_string_array(meals_prices_tuple->value->cstring, s_meal_subtitles, MAX_MEALS);
+    int count_names = parse_string_array(meals_names_tuple->value->cstring, s_meal_titles, MAX_MEALS, &s_meal_arena);
+    int count_prices = parse_string_array(meals_prices_tuple->value->cstring, s_meal_subtitles, MAX_MEALS, &s_meal_arena);
     
     // Use the minimum count among the arrays.
     s_meal_count = count_ids;
     if (count_names < s_meal_count) s_meal_count = count_names;
     if (count_prices < s_meal_count) s_meal_count = count_prices;
+    meals_single_section();
     
-    // Process each meal title.
-    for (int i = 0; i < s_meal_count; i++) {
-      char *name = s_meal_titles[i];
-      // Check for prefix ("Vegan" or "Vegetarian") to remove if present.
-      if ((strncasecmp(name, "vegan", 5) == 0 && (name[5]==' ' || name[5]==':'))) {
-        char *p = name;
-        if (strncasecmp(p, "vegan:", 6)==0) {
-          p += 6;
-        } else {
-          p += 5;
-        }
-        while (*p == ' ' || *p == ':') { p++; }
-        memmove(name, p, strlen(p)+1);
-        s_meal_bitmaps[i] = gbitmap_create_with_resource(IMAGE_VEGAN);
-      } else if ((strncasecmp(name, "vegetarian", 10) == 0 && (name[10]==' ' || name[10]==':'))) {
-        char *p = name;
-        if (strncasecmp(p, "vegetarian:", 11) == 0) {
-          p += 11;
-        } else {
-          p += 10;
-        }
-        while (*p == ' ' || *p == ':') { p++; }
-        memmove(name, p, strlen(p)+1);
-        s_meal_bitmaps[i] = gbitmap_create_with_resource(IMAGE_VEGETARIAN);
-      } else if ((strncasecmp(name, "vegetarisch", 11) == 0 && (name[11]==' ' || name[11]==':'))) {
-        char *p = name;
-        if (strncasecmp(p, "vegetarisch:", 12) == 0) {
-          p += 12;
-        } else {
-          p += 11;
-        }
-        while (*p == ' ' || *p == ':') { p++; }
-        memmove(name, p, strlen(p)+1);
-        s_meal_bitmaps[i] = gbitmap_create_with_resource(IMAGE_VEGETARIAN);
-      } else if (strcasestr(name, "vegan") != NULL) {
-        s_meal_bitmaps[i] = gbitmap_create_with_resource(IMAGE_VEGAN);
-      } else if (strcasestr(name, "vegetarian") != NULL || strcasestr(name, "vegetarisch") != NULL) {
-        s_meal_bitmaps[i] = gbitmap_create_with_resource(IMAGE_VEGETARIAN);
-      } else {
-        s_meal_bitmaps[i] = gbitmap_create_with_resource(IMAGE_POT);
-      }
-    }
-    
-    if (!s_meals_window) {
-      create_meals_window();
-    } else {
-      // If meals window already exists, reload its menu data.
-      if(s_meals_menu_layer != NULL) {
-        menu_layer_reload_data(s_meals_menu_layer);
-      }
-    }
-    window_stack_push(s_meals_window, true);
-    window_stack_push(s_meals_window, true);
+    s_meals_stale = false;
+    classify_meals();
+    show_meals_window();
   }
-  
-  menu_layer_reload_data(s_menu_layer);
 }
 
 static void inbox_dropped_callback(AppMessageResult reason, void *context) {
   // A message was received, but had to be dropped
   APP_LOG(APP_LOG_LEVEL_ERROR, "Message dropped. Reason: %d", (int)reason);
+  s_diag.dropped++;
+  s_diag.last_drop_reason = reason;
 }
 
 
 static void prv_init(void) {
+  // Use the watch's language for the weekday names.
+  setlocale(LC_ALL, "");
+
+  if (launch_reason() == APP_LAUNCH_WAKEUP) {
+    s_prewarm = true;
+    if (!prewarm_begin()) {
+      // Ran recently; exit right away without touching the network.
+      prewarm_schedule();
+      return;
+    }
+  }
+  wakeup_service_subscribe(wakeup_handler);
+  dict_load();
+
   s_window = window_create();
-  window_set_window_handlers(s_window, (WindowHandlers) {
-    .load = prv_window_load,
-    .unload = prv_window_unload,
-  });
-  window_stack_push(s_window, true);
+  if (s_prewarm) {
+    // An empty window keeps the app running until the meals are stored; the day list is
+    // neither loaded nor drawn.
+    window_stack_push(s_window, false);
+  } else {
+    window_set_window_handlers(s_window, (WindowHandlers) {
+      .load = prv_window_load,
+      .unload = prv_window_unload,
+    });
+    window_stack_push(s_window, true);
+  }
+  // The phone sends the day list on its own once it is ready.
+  diag_request_sent(REQUEST_DAYS);
+  diag_sample_heap();
 
   // Initialize AppMessage and set inbox handler
   app_message_register_inbox_received(inbox_received_callback);
   app_message_register_inbox_dropped(inbox_dropped_callback);
-  app_message_open(1024, 1024);
+  app_message_register_outbox_sent(outbox_sent_callback);
+  app_message_register_outbox_failed(outbox_failed_callback);
+  s_inbox_size = app_message_inbox_size_maximum();
+  if (s_inbox_size > APP_MESSAGE_INBOX_SIZE) {
+    s_inbox_size = APP_MESSAGE_INBOX_SIZE;
+  }
+  app_message_open(s_inbox_size, APP_MESSAGE_OUTBOX_SIZE);
+  send_hello(NULL);
 }
 
 static void prv_deinit(void) {
-  window_destroy(s_window);
+  // Scheduling on every exit keeps exactly one pending pre-warm.
+  prewarm_schedule();
+  arena_report_stats();
+  if (s_state_timer) {
+    app_timer_cancel(s_state_timer);
+  }
+  xfer_reset();
+  detail_cache_clear();
+  if (s_window) {
+    window_destroy(s_window);
+  }
 }
 
 int main(void) {
@@ -0,0 +1,159 @@
+// Dictionary of words that recur in meal names across days. It is kept in localStorage and
+// mirrored on the watch (see "Name dictionary" in OpenMensa.c), so meal names can be sent
+// with references into it instead of the words themselves.
+//
+// The dictionary only grows; entry i keeps its meaning for the lifetime of the dictionary id.
+// In an encoded name, REF followed by the byte i + 1 stands for entry i. REF never occurs in
+// UTF-8 and i + 1 is never 0, so encoded names are still terminated strings on the watch.
+var REF = 0xFF;
+var VERSION = 1;           // Of the XFER_KIND_DICT payload, must match DICT_DATA_VERSION in OpenMensa.c.
+var MAX_ENTRIES = 255;
+var MIN_WORD_BYTES = 4;    // Shorter words do not gain enough from a 2 byte reference.
+var MIN_SEEN = 2;          // A word becomes an entry once it was seen this often.
+var MAX_CANDIDATES = 512;  // Words counted towards MIN_SEEN.
+var STORAGE_KEY = "nameDictionary";
+
+function utf8(str) {
+  var encoded = unescape(encodeURIComponent(str));
+  var bytes = [];
+  for (var i = 0; i < encoded.length; i++) {
+    bytes.push(encoded.charCodeAt(i));
+  }
+  return bytes;
+}
+
+function load() {
+  var stored = null;
+  try {
+    stored = JSON.parse(localStorage.getItem(STORAGE_KEY) || "null");
+  } catch (err) {
+    console.log("Dropping unreadable name dictionary: " + err);
+  }
+  if (!stored || !stored.id || !Array.isArray(stored.entries)) {
+    // A new id tells the watch to drop what it holds from an earlier dictionary.
+    stored = { id: 1 + Math.floor(Math.random() * 0xFFFE), entries: [], candidates: {} };
+  }
+  var index = {};
+  stored.entries.forEach(function(word, i) { index[word] = i; });
+  stored.index = index;
+  return stored;
+}
+
+var dictionary = load();
+// What the watch reported in its last request; entries it does not hold yet are synced first.
+var watch = { id: 0, count: 0, capacity: 0 };
+
+function save() {
+  localStorage.setItem(STORAGE_KEY, JSON.stringify({
+    id: dictionary.id,
+    entries: dictionary.entries,
+    candidates: dictionary.candidates
+  }));
+}
+
+// Counts the words of names and adds the ones that keep recurring.
+function learn(names) {
+  var changed = false;
+  names.forEach(function(name) {
+    name.split(" ").forEach(function(word) {
+      if (dictionary.index[word] !== undefined || utf8(word).length < MIN_WORD_BYTES ||
+          dictionary.entries.length >= MAX_ENTRIES) {
+        return;
+      }
+      var seen = (dictionary.candidates[word] || 0) + 1;
+      changed = true;
+      if (seen < MIN_SEEN) {
+        if (Object.keys(dictionary.candidates).length >= MAX_CANDIDATES) {
+          dictionary.candidates = {};
+        }
+        dictionary.candidates[word] = seen;
+        return;
+      }
+      delete dictionary.candidates[word];
+      dictionary.index[word] = dictionary.entries.length;
+      dictionary.entries.push(word);
+    });
+  });
+  if (changed) {
+    save();
+  }
+}
+
+// Records the DICT_ID, DICT_COUNT and DICT_CAPACITY the watch sent with a request.
+function setWatchState(payload) {
+  if (payload.DICT_ID === undefined) { return; }
+  watch = { id: payload.DICT_ID, count: payload.DICT_COUNT || 0, capacity: payload.DICT_CAPACITY || 0 };
+}
+
+// Entries from 0 on that fit the watch's capacity, each stored there as [length][bytes].
+function entriesForWatch() {
+  var bytes = 0;
+  var count = 0;
+  while (count < dictionary.entries.length) {
+    bytes += 1 + utf8(dictionary.entries[count]).length;
+    if (bytes > watch.capacity) { break; }
+    count++;
+  }
+  return count;
+}
+
+// Returns the XFER_KIND_DICT payload with the entries the watch is missing, or null:
+// [version][id:2 LE][first entry][count] then [length][bytes] per entry.
+// Names only refer to the new entries once synced() reports the payload delivered.
+function syncPayload() {
+  var count = entriesForWatch();
+  var first = watch.id === dictionary.id ? watch.count : 0;
+  if (first >= count) { return null; }
+  var bytes = [VERSION, dictionary.id & 0xFF, (dictionary.id >> 8) & 0xFF, first, count - first];
+  dictionary.entries.slice(first, count).forEach(function(word) {
+    var encoded = utf8(word);
+    bytes.push(encoded.length);
+    Array.prototype.push.apply(bytes, encoded);
+  });
+  return bytes;
+}
+
+// Records that the watch stored a payload from syncPayload. The watch reports what it really
+// holds with its next request anyway; this lets names refer to the new entries before that.
+function synced(bytes) {
+  var id = bytes[1] | (bytes[2] << 8);
+  var holds = watch.id === id ? watch.count : 0;
+  var count = bytes[3] + bytes[4];
+  if (bytes[3] <= holds && count > holds) {
+    watch = { id: id, count: count, capacity: watch.capacity };
+  }
+}
+
+// Encodes name as UTF-8 with references to the entries the watch holds, cut to maxBytes
+// without splitting a reference or a character.
+function encodeName(name, maxBytes) {
+  var usable = watch.id === dictionary.id ? watch.count : 0;
+  var bytes = [];
+  name.split(" ").some(function(word, i) {
+    var entry = dictionary.index[word];
+    var isRef = entry !== undefined && entry < usable;
+    var encoded = isRef ? [REF, entry + 1] : utf8(word);
+    if (i > 0) {
+      encoded.unshift(0x20);
+    }
+    if (bytes.length + encoded.length > maxBytes) {
+      if (!isRef) {
+        var end = maxBytes - bytes.length;
+        while (end > 0 && (encoded[end] & 0xC0) === 0x80) { end--; }
+        Array.prototype.push.apply(bytes, encoded.slice(0, end));
+      }
+      return true;
+    }
+    Array.prototype.push.apply(bytes, encoded);
+    return false;
+  });
+  return bytes;
+}
+
+module.exports = {
+  learn: learn,
+  setWatchState: setWatchState,
+  syncPayload: syncPayload,
+  synced: synced,
+  encodeName: encodeName
+};
@@ -0,0 +1,89 @@
+// Derives per-meal attribute flags from the OpenMensa category, notes and name.
+// The flag values must match the MEAL_FLAG_* defines in OpenMensa.c.
+var FLAGS = {
+  VEGAN: 0x01,
+  VEGETARIAN: 0x02,
+  FISH: 0x04,
+  PORK: 0x08,
+  BEEF: 0x10,
+  POULTRY: 0x20,
+  ALCOHOL: 0x40
+};
+
+// Keywords per language, matched case-insensitively as substrings so German compounds
+// like "Schweinebraten" are found. Add a language by adding another key to each rule.
+var RULES = [
+  { flag: FLAGS.VEGAN, keywords: {
+    de: ["vegan"],
+    en: ["vegan"] } },
+  { flag: FLAGS.VEGETARIAN, keywords: {
+    de: ["vegetarisch", "fleischlos"],
+    en: ["vegetarian", "veggie", "meatless"] } },
+  { flag: FLAGS.FISH, keywords: {
+    de: ["fisch", "lachs", "kabeljau", "forelle", "hering", "thunfisch", "garnele", "meeresfrüchte"],
+    en: ["fish", "salmon", "cod", "trout", "tuna", "shrimp", "seafood"] } },
+  { flag: FLAGS.PORK, keywords: {
+    de: ["schwein", "speck", "schinken"],
+    en: ["pork", "bacon"] } },
+  { flag: FLAGS.BEEF, keywords: {
+    de: ["rind", "kalb"],
+    en: ["beef", "veal"] } },
+  { flag: FLAGS.POULTRY, keywords: {
+    de: ["geflügel", "hähnchen", "huhn", "pute"],
+    en: ["poultry", "chicken", "turkey"] } },
+  { flag: FLAGS.ALCOHOL, keywords: {
+    de: ["alkohol"],
+    en: ["alcohol"] } }
+];
+
+// Leading diet labels the canteens put in front of the dish name.
+var NAME_PREFIX = /^(vegan|vegetarian|vegetarisch)[ :][\s:]*/i;
+
+var DEFAULT_LANGUAGES = ["de", "en"];
+
+// Languages of the DIET_LANGUAGES setting, a comma separated list like "de,en". Falls back to
+// DEFAULT_LANGUAGES when the setting names none that RULES has keywords for.
+function parseLanguages(setting) {
+  var languages = (setting || "").split(",").map(function(language) {
+    return language.trim().toLowerCase();
+  }).filter(function(language) {
+    return RULES.some(function(rule) { return rule.keywords[language]; });
+  });
+  return languages.length ? languages : DEFAULT_LANGUAGES;
+}
+
+function matchesRule(rule, text, languages) {
+  return languages.some(function(language) {
+    var keywords = rule.keywords[language] || [];
+    return keywords.some(function(keyword) {
+      return text.indexOf(keyword) !== -1;
+    });
+  });
+}
+
+// Returns { name, flags } with the diet prefix stripped from the name.
+function classifyMeal(meal, languages) {
+  languages = languages || DEFAULT_LANGUAGES;
+  var name = meal.name || "";
+  var text = [name, meal.category || ""].concat(meal.notes || []).join(" ").toLowerCase();
+  var flags = 0;
+  RULES.forEach(function(rule) {
+    if (matchesRule(rule, text, languages)) {
+      flags |= rule.flag;
+    }
+  });
+  if (flags & FLAGS.VEGAN) {
+    flags |= FLAGS.VEGETARIAN;
+  }
+  return {
+    name: name.replace(NAME_PREFIX, ""),
+    flags: flags
+  };
+}
+
+module.exports = {
+  FLAGS: FLAGS,
+  RULES: RULES,
+  parseLanguages: parseLanguages,
+  classifyMeal: classifyMeal
+};
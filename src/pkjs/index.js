@@ -1,24 +1,552 @@
 var Clay = require('pebble-clay');
 var clayConfig = require('./config.json');
 var messageKeys = require('message_keys');
+var diet = require('./diet');
+var noteTable = require('./notes');
+var dictionary = require('./dictionary');
+var store = require('./store');
 var clay = new Clay(clayConfig);
 
-// Global variable to cache the full meals JSON.
-var cachedMeals = null;
+// OpenMensa API root; can be pointed at a mirror or a local replay server in the settings.
+var DEFAULT_API_BASE_URL = "https://openmensa.org/api/v2";
+
+function apiBaseUrl() {
+  var url = localStorage.getItem("API_BASE_URL") || DEFAULT_API_BASE_URL;
+  return url.replace(/\/+$/, "");
+}
+
 var openmensaID = null;
 
+// Several canteens can be configured as a comma separated list of OpenMensa IDs.
+// The watch shows one meals section per canteen, see MAX_SECTIONS in OpenMensa.c.
+var MAX_CANTEENS = 4;
+
+function canteenIDs() {
+  return (openmensaID || "").split(/[\s,;]+/).filter(function(id) {
+    return /^\d+$/.test(id);
+  }).slice(0, MAX_CANTEENS);
+}
+
+// Canteen names from the API, keyed by ID and kept in localStorage.
+var canteenNames = JSON.parse(localStorage.getItem("canteenNames") || "{}");
+
+function fetchCanteenName(canteen) {
+  if (canteenNames[canteen]) { return; }
+  var req = new XMLHttpRequest();
+  req.onload = function() {
+    if (req.status >= 200 && req.status < 300) {
+      try {
+        canteenNames[canteen] = JSON.parse(req.responseText).name;
+        localStorage.setItem("canteenNames", JSON.stringify(canteenNames));
+      } catch(ex) {
+        console.log("Error parsing canteen JSON:", ex);
+      }
+    }
+  };
+  req.open("GET", apiBaseUrl() + "/canteens/" + canteen);
+  req.send();
+}
+
+// Meal requests keyed by canteen and API date ("ID/YYYY-MM-DD") like the meal store, still
+// queued or in flight as { callbacks, xhr, onDemand }.
+var pendingMeals = {};
+var prefetchQueue = [];
+var activeFetches = 0;
+var MAX_CONCURRENT_FETCHES = 3;
+var MEALS_FETCH_TIMEOUT = 10000;  // ms a meals request, or a day across all canteens, may take.
+// MEALS_UNAVAILABLE reasons, must match MEALS_UNAVAILABLE_* in OpenMensa.c.
+var MEALS_UNAVAILABLE_NONE = 1;    // No canteen serves meals that day.
+var MEALS_UNAVAILABLE_FAILED = 2;  // No canteen could be fetched, nor answered from the store.
+var MEALS_REVALIDATE_AFTER = 10 * 60 * 1000;  // ms before a shown day is fetched again.
+var selectedApiDate = null;   // Latest SELECTED_DATE; answers for older selections are dropped.
+var dayListRequests = [];
+
+// Outbound AppMessages are sent one at a time from sendQueue as { payload, slot, attempts, onSent, onFailed }.
+var sendQueue = [];
+var sendInFlight = false;
+var SEND_MAX_RETRIES = 4;
+var SEND_BACKOFF_BASE = 250;  // ms, doubled on every retry.
+
+// Version of the MEALS_DATA byte layout, must match MEALS_DATA_VERSION in OpenMensa.c.
+var MEALS_DATA_VERSION = 3;
+var MEALS_DATA_NO_PRICE = 0xFFFF;
+var MAX_MEALS = 255;
+var MAX_NAME_BYTES = 255;
+
+// Meal list deltas against the last list sent for a day, sent as XFER_KIND_MEALS_DELTA:
+// [version][base revision:4 LE][op count] then per op
+//   remove: [1][id:4 LE]
+//   add:    [2][section][row][meal record as in MEALS_DATA]
+//   change: [3][id:4 LE][fields] then the changed fields: price [cents:2 LE], flags [1], name [length][bytes]
+// Must match the MEALS_DELTA_* defines in OpenMensa.c.
+var MEALS_DELTA_VERSION = 1;
+var DELTA_OP_REMOVE = 1;
+var DELTA_OP_ADD = 2;
+var DELTA_OP_CHANGE = 3;
+var DELTA_FIELD_PRICE = 0x01;
+var DELTA_FIELD_FLAGS = 0x02;
+var DELTA_FIELD_NAME = 0x04;
+// Last list sent per day number as { rev, sections }; the watch reports the revision it holds.
+var lastSentByDay = {};
+
+// Datasets carry a content hash: DAYS_HASH for the day list, and the meal list's hash is its
+// revision. The watch reports the hashes it holds and gets a "not modified" reply when they
+// still match, even after this script was restarted.
+var watchDaysHash = 0;
+
+// 31 bit FNV-1a hash of str, never 0, so it fits a positive int32 AppMessage value.
+function contentHash(str) {
+  var hash = 0x811C9DC5;
+  for (var i = 0; i < str.length; i++) {
+    hash ^= str.charCodeAt(i);
+    // hash *= 16777619 (the FNV prime) in 32 bits.
+    hash = (hash + (hash << 1) + (hash << 4) + (hash << 7) + (hash << 8) + (hash << 24)) >>> 0;
+  }
+  return (hash & 0x7FFFFFFF) || 1;
+}
+
+// Chunked transfer of large payloads, see the "Chunked transfer" section in OpenMensa.c.
+var XFER_KIND_MEALS = 1;
+var XFER_KIND_DETAILS = 2;
+var XFER_KIND_MEALS_DELTA = 3;
+var XFER_KIND_MEALS_PAGE = 4;
+var XFER_KIND_DICT = 5;
+
+// Long lists go out as the first page with the full section table; the watch asks for the
+// rest with MEALS_PAGE as the user scrolls. Must match MEALS_PAGE_* in OpenMensa.c.
+var MEALS_PAGE_SIZE = 10;
+var MEALS_PAGE_VERSION = 1;
+
+// Memory level reported by the watch's governor (MEM_LEVEL_* in OpenMensa.c).
+var MEM_LEVEL_SHORT_NAMES = 2;
+var MEM_LEVEL_FEW_ROWS = 3;
+var watchMemLevel = 0;
+
+function firstPageSize() {
+  return watchMemLevel >= MEM_LEVEL_FEW_ROWS ? MEALS_PAGE_SIZE / 2 : MEALS_PAGE_SIZE;
+}
+var XFER_WINDOW = 2;          // Chunks in flight before waiting for an ack.
+var XFER_ACK_TIMEOUT = 2000;  // ms without an ack before the window is resent.
+var XFER_MAX_RETRIES = 5;
+var xferChunkSize = 512;      // Updated from XFER_CHUNK_SIZE sent by the watch.
+// Starts anywhere in 1..255, so the ids of a restarted phone do not repeat the one the watch
+// finished last and get its final ack instead of a transfer.
+var xferNextId = 1 + Math.floor(Math.random() * 255);
+var activeTransfer = null;
+var transferQueue = [];
+
+// Version of the detail records pushed as XFER_KIND_DETAILS, must match DETAILS_DATA_VERSION in OpenMensa.c.
+var DETAILS_DATA_VERSION = 2;
+var MAX_NOTES_BYTES = 1024;
+
+// Queues payload for the watch. A message with a slot replaces any queued message of the same
+// slot that has not been sent yet, so only the newest state for that slot goes over the air.
+function enqueueMessage(payload, slot, onSent, onFailed) {
+  if (slot) {
+    sendQueue = sendQueue.filter(function(item, index) {
+      return item.slot !== slot || (sendInFlight && index === 0);
+    });
+  }
+  sendQueue.push({ payload: payload, slot: slot || null, attempts: 0, onSent: onSent, onFailed: onFailed });
+  sendNextMessage();
+}
+
+function sendNextMessage() {
+  if (sendInFlight || sendQueue.length === 0) { return; }
+  var item = sendQueue[0];
+  sendInFlight = true;
+  Pebble.sendAppMessage(item.payload, function(e) {
+    sendQueue.shift();
+    sendInFlight = false;
+    if (item.onSent) { item.onSent(); }
+    sendNextMessage();
+  }, function(e) {
+    sendInFlight = false;
+    if (++item.attempts > SEND_MAX_RETRIES) {
+      console.log("Message " + (item.slot || "") + " dropped after " + SEND_MAX_RETRIES + " retries");
+      sendQueue.shift();
+      if (item.onFailed) { item.onFailed(); }
+      sendNextMessage();
+      return;
+    }
+    // Hold the queue and retry the same message with exponential backoff.
+    sendInFlight = true;
+    setTimeout(function() {
+      sendInFlight = false;
+      sendNextMessage();
+    }, SEND_BACKOFF_BASE * Math.pow(2, item.attempts - 1));
+  });
+}
+
+// Returns the UTF-8 bytes of str, cut at a character boundary so it fits in maxBytes.
+function utf8Bytes(str, maxBytes) {
+  var encoded = unescape(encodeURIComponent(str));
+  var bytes = [];
+  for (var i = 0; i < encoded.length; i++) {
+    bytes.push(encoded.charCodeAt(i));
+  }
+  if (bytes.length > maxBytes) {
+    var end = maxBytes;
+    // Step back over continuation bytes so we don't split a character.
+    while (end > 0 && (bytes[end] & 0xC0) === 0x80) { end--; }
+    bytes = bytes.slice(0, end);
+  }
+  return bytes;
+}
+
+// Packs the meals of each canteen section into the binary MEALS_DATA layout:
+// [version][count][section count] then per section [meal count:1][name length:1][name bytes]
+// and then per meal [id:4 LE][price cents:2 LE][flags:1][name length:1][name bytes].
+// Meal names may hold references into the name dictionary, see dictionary.js.
+// With a limit only the first limit meal records are included; count still covers all meals.
+function encodeMeals(sections, limit) {
+  var meals = [];
+  var header = [];
+  sections.forEach(function(section) {
+    var sectionMeals = section.meals.slice(0, Math.min(255, MAX_MEALS - meals.length));
+    var name = utf8Bytes(section.name, MAX_NAME_BYTES);
+    header.push(sectionMeals.length, name.length);
+    Array.prototype.push.apply(header, name);
+    meals = meals.concat(sectionMeals);
+  });
+  var bytes = [MEALS_DATA_VERSION, meals.length, sections.length].concat(header);
+  meals.slice(0, limit === undefined ? meals.length : limit).forEach(function(meal) {
+    Array.prototype.push.apply(bytes, encodeMealRecord(meal));
+  });
+  return bytes;
+}
+
+// The meals of all sections in list order, as encodeMeals counts them.
+function flattenSections(sections) {
+  var meals = [];
+  sections.forEach(function(section) {
+    meals = meals.concat(section.meals.slice(0, Math.min(255, MAX_MEALS - meals.length)));
+  });
+  return meals;
+}
+
+// [version][revision:4 LE][first][count] then the meal records.
+function encodeMealPage(rev, meals, first, count) {
+  var page = meals.slice(first, first + count);
+  var bytes = [MEALS_PAGE_VERSION];
+  pushId(bytes, rev);
+  bytes.push(first, page.length);
+  page.forEach(function(meal) {
+    Array.prototype.push.apply(bytes, encodeMealRecord(meal));
+  });
+  return bytes;
+}
+
+function mealCents(meal) {
+  var cents = meal.price !== null ? Math.round(meal.price * 100) : MEALS_DATA_NO_PRICE;
+  return (cents < 0 || cents >= MEALS_DATA_NO_PRICE) ? MEALS_DATA_NO_PRICE : cents;
+}
+
+function pushId(bytes, id) {
+  bytes.push(id & 0xFF, (id >> 8) & 0xFF, (id >> 16) & 0xFF, (id >>> 24) & 0xFF);
+}
+
+// [id:4 LE][price cents:2 LE][flags:1][name length:1][name bytes]
+function encodeMealRecord(meal) {
+  var cents = mealCents(meal);
+  var name = dictionary.encodeName(meal.name, MAX_NAME_BYTES);
+  var bytes = [];
+  pushId(bytes, meal.id);
+  bytes.push(cents & 0xFF, (cents >> 8) & 0xFF);
+  bytes.push(meal.flags & 0xFF);
+  bytes.push(name.length);
+  Array.prototype.push.apply(bytes, name);
+  return bytes;
+}
+
+// Encodes the changes from base to sections, or returns null when a full list is the better
+// choice: the canteen sections differ, meals were reordered, or the delta is not smaller.
+function encodeMealsDelta(base, sections, fullLength) {
+  if (base.sections.length !== sections.length) { return null; }
+  var ops = [];
+  for (var s = 0; s < sections.length; s++) {
+    var oldMeals = base.sections[s].meals;
+    var newMeals = sections[s].meals;
+    if (base.sections[s].name !== sections[s].name) { return null; }
+    var newById = {};
+    newMeals.forEach(function(meal) { newById[meal.id] = meal; });
+    var oldById = {};
+    var kept = [];
+    oldMeals.forEach(function(meal) {
+      oldById[meal.id] = meal;
+      if (newById[meal.id]) {
+        kept.push(meal.id);
+      } else {
+        var op = [DELTA_OP_REMOVE];
+        pushId(op, meal.id);
+        ops.push(op);
+      }
+    });
+    var keptIndex = 0;
+    for (var row = 0; row < newMeals.length; row++) {
+      var meal = newMeals[row];
+      var old = oldById[meal.id];
+      if (!old) {
+        ops.push([DELTA_OP_ADD, s, row].concat(encodeMealRecord(meal)));
+        continue;
+      }
+      if (kept[keptIndex++] !== meal.id) { return null; }
+      var fields = 0;
+      var op = [DELTA_OP_CHANGE];
+      pushId(op, meal.id);
+      op.push(0);
+      if (mealCents(old) !== mealCents(meal)) {
+        fields |= DELTA_FIELD_PRICE;
+        op.push(mealCents(meal) & 0xFF, (mealCents(meal) >> 8) & 0xFF);
+      }
+      if (old.flags !== meal.flags) {
+        fields |= DELTA_FIELD_FLAGS;
+        op.push(meal.flags & 0xFF);
+      }
+      if (old.name !== meal.name) {
+        var name = dictionary.encodeName(meal.name, MAX_NAME_BYTES);
+        fields |= DELTA_FIELD_NAME;
+        op.push(name.length);
+        Array.prototype.push.apply(op, name);
+      }
+      if (fields) {
+        op[5] = fields;
+        ops.push(op);
+      }
+    }
+  }
+  if (ops.length > 255) { return null; }
+  var bytes = [MEALS_DELTA_VERSION];
+  pushId(bytes, base.rev);
+  bytes.push(ops.length);
+  ops.forEach(function(op) { Array.prototype.push.apply(bytes, op); });
+  return bytes.length < fullLength ? bytes : null;
+}
+
+// Sends bytes to the watch as sequence-numbered chunks, keeping XFER_WINDOW chunks in flight.
+// extra is merged into the first chunk. Transfers run one after another; a transfer with a
+// slot replaces any queued or running transfer of the same slot. onComplete is called once
+// the watch acknowledged every chunk.
+function sendChunked(kind, bytes, extra, slot, onComplete) {
+  if (slot) {
+    transferQueue = transferQueue.filter(function(transfer) { return transfer.slot !== slot; });
+    if (activeTransfer && activeTransfer.slot === slot) {
+      clearTimeout(activeTransfer.timer);
+      purgeChunks(activeTransfer);
+      activeTransfer = null;
+    }
+  }
+  var chunks = [];
+  for (var offset = 0; offset < bytes.length; offset += xferChunkSize) {
+    chunks.push({ offset: offset, data: bytes.slice(offset, offset + xferChunkSize) });
+  }
+  transferQueue.push({
+    id: 0,         // Assigned when the transfer starts.
+    kind: kind,
+    slot: slot || null,
+    total: bytes.length,
+    chunks: chunks,
+    extra: extra || {},
+    acked: 0,      // Chunks the watch confirmed.
+    delivered: 0,  // Chunks the send queue delivered, acknowledged or not.
+    nextSeq: 0,    // Next chunk to send.
+    retries: 0,
+    timer: null,
+    onComplete: onComplete || null
+  });
+  if (!activeTransfer) {
+    startNextTransfer();
+  }
+}
+
+function startNextTransfer() {
+  activeTransfer = transferQueue.shift() || null;
+  if (!activeTransfer) { return; }
+  activeTransfer.id = xferNextId;
+  xferNextId = (xferNextId % 255) + 1;
+  pumpTransfer();
+}
+
+function pumpTransfer() {
+  var transfer = activeTransfer;
+  if (!transfer) { return; }
+  while (transfer.nextSeq < transfer.chunks.length && transfer.nextSeq < transfer.acked + XFER_WINDOW) {
+    sendChunk(transfer, transfer.nextSeq);
+    transfer.nextSeq++;
+  }
+}
+
+// Waits XFER_ACK_TIMEOUT for the watch's ack after the last chunk went out. The timer only
+// runs once a chunk was delivered, so it never overlaps the send queue's own retries of it.
+function armAckTimer(transfer) {
+  clearTimeout(transfer.timer);
+  transfer.timer = setTimeout(function() {
+    retransmit(transfer, transfer.acked);
+  }, XFER_ACK_TIMEOUT);
+}
+
+function sendChunk(transfer, seq) {
+  var chunk = transfer.chunks[seq];
+  var message = {
+    "XFER_ID": transfer.id,
+    "XFER_SEQ": seq,
+    "XFER_OFFSET": chunk.offset,
+    "XFER_TOTAL": transfer.total,
+    "XFER_KIND": transfer.kind,
+    "XFER_DATA": chunk.data
+  };
+  if (seq === 0) {
+    for (var key in transfer.extra) { message[key] = transfer.extra[key]; }
+  }
+  // Delivered chunks are acknowledged by the watch with XFER_ACK once they are reassembled.
+  enqueueMessage(message, null, function() {
+    if (transfer !== activeTransfer) { return; }
+    transfer.delivered = Math.max(transfer.delivered, seq + 1);
+    armAckTimer(transfer);
+  }, function() {
+    console.log("Chunk " + seq + " of transfer " + transfer.id + " was not delivered");
+    retransmit(transfer, seq);
+  });
+}
+
+// Drops the chunks of transfer still waiting in the send queue; one already being sent (or
+// waiting for its retry) finishes on its own and is ignored by the watch if stale.
+function purgeChunks(transfer) {
+  sendQueue = sendQueue.filter(function(item, index) {
+    return item.payload.XFER_ID !== transfer.id || (sendInFlight && index === 0);
+  });
+}
+
+// Goes back to chunk seq and resends from there.
+function retransmit(transfer, seq) {
+  if (transfer !== activeTransfer || seq >= transfer.chunks.length) { return; }
+  clearTimeout(transfer.timer);
+  purgeChunks(transfer);
+  if (++transfer.retries > XFER_MAX_RETRIES) {
+    console.log("Transfer " + transfer.id + " failed after " + XFER_MAX_RETRIES + " retries");
+    startNextTransfer();
+    return;
+  }
+  transfer.nextSeq = Math.max(seq, transfer.acked);
+  transfer.delivered = transfer.acked;
+  pumpTransfer();
+}
+
+function handleTransferReply(payload) {
+  var transfer = activeTransfer;
+  if (!transfer || payload.XFER_ID !== transfer.id) { return; }
+  if (payload.XFER_NACK !== undefined) {
+    retransmit(transfer, payload.XFER_NACK);
+    return;
+  }
+  if (payload.XFER_ACK > transfer.acked) {
+    transfer.acked = payload.XFER_ACK;
+    transfer.retries = 0;
+    // Keep waiting only for delivered chunks the watch has not confirmed yet.
+    if (transfer.acked < transfer.delivered) {
+      armAckTimer(transfer);
+    } else {
+      clearTimeout(transfer.timer);
+    }
+  }
+  if (transfer.acked >= transfer.chunks.length) {
+    clearTimeout(transfer.timer);
+    if (transfer.onComplete) { transfer.onComplete(); }
+    startNextTransfer();
+    return;
+  }
+  pumpTransfer();
+}
+
+// Name, price and notes shown in the watch's detail window.
+function mealDetail(mealInfo) {
+  var pricingCategory = localStorage.getItem("MEAL_PRICE") || "students";
+  var singlePrice = (mealInfo.prices && mealInfo.prices[pricingCategory]) ?
+                       mealInfo.prices[pricingCategory].toFixed(2) + "€" : "N/A";
+  return { name: mealInfo.name, price: singlePrice };
+}
+
+// MEAL_NOTES goes out in one message with MEAL_NAME and MEAL_PRICE, so the notes get what of
+// a chunk the two strings and their terminators leave.
+function messageNotesBudget(detail) {
+  return xferChunkSize - utf8Bytes(detail.name, Infinity).length - utf8Bytes(detail.price, Infinity).length - 2;
+}
+
+// Encodes notes as [count:1] then per note its code into the watch's NOTE_TABLE resource,
+// or noteTable.LITERAL followed by [length:1][bytes] for notes the table does not know.
+// Notes that would exceed maxBytes are left out.
+function encodeNotes(mealNotes, maxBytes) {
+  var bytes = [0];
+  mealNotes.slice(0, 255).forEach(function(note) {
+    var code = noteTable.codeFor(note);
+    var encoded = [code];
+    if (code === noteTable.LITERAL) {
+      var text = utf8Bytes(note, 255);
+      encoded = [code, text.length].concat(text);
+    }
+    if (bytes.length + encoded.length > maxBytes) {
+      return;
+    }
+    Array.prototype.push.apply(bytes, encoded);
+    bytes[0]++;
+  });
+  return bytes;
+}
+
+// Encodes one detail record: [id:4 LE][name length:1][name][price length:1][price][notes length:2 LE][notes]
+// with the notes as encoded by encodeNotes.
+function encodeDetail(mealInfo) {
+  var detail = mealDetail(mealInfo);
+  var name = utf8Bytes(detail.name, MAX_NAME_BYTES);
+  var price = utf8Bytes(detail.price, 255);
+  var notes = encodeNotes(mealInfo.notes || [], MAX_NOTES_BYTES);
+  var bytes = [mealInfo.id & 0xFF, (mealInfo.id >> 8) & 0xFF, (mealInfo.id >> 16) & 0xFF, (mealInfo.id >>> 24) & 0xFF];
+  bytes.push(name.length);
+  Array.prototype.push.apply(bytes, name);
+  bytes.push(price.length);
+  Array.prototype.push.apply(bytes, price);
+  bytes.push(notes.length & 0xFF, (notes.length >> 8) & 0xFF);
+  Array.prototype.push.apply(bytes, notes);
+  return bytes;
+}
+
+// Details of the first page of meals go to the watch ahead of a tap, as one transfer that fits
+// a chunk. Rows are pushed last first, so the rows on screen end up most recently used in the
+// watch's detail LRU and stay when it holds fewer entries than a page. Details the watch got
+// since it launched are not pushed again; pushedDetails maps meal id to the hash of the record.
+var pushedDetails = {};
+
+function pushMealDetails(meals) {
+  var records = [];
+  var hashes = {};
+  var bytes = 2;
+  meals.slice(0, firstPageSize()).some(function(meal) {
+    var record = encodeDetail(meal);
+    var hash = contentHash(record.join(","));
+    if (pushedDetails[meal.id] === hash) { return false; }
+    if (bytes + record.length > xferChunkSize) { return true; }
+    records.unshift(record);
+    hashes[meal.id] = hash;
+    bytes += record.length;
+    return false;
+  });
+  if (records.length === 0) { return; }
+  var payload = [DETAILS_DATA_VERSION, records.length];
+  records.forEach(function(record) { Array.prototype.push.apply(payload, record); });
+  // A newer push replaces one still queued or running; only a delivered push counts.
+  sendChunked(XFER_KIND_DETAILS, payload, null, "details", function() {
+    for (var id in hashes) { pushedDetails[id] = hashes[id]; }
+  });
+}
+
 Pebble.addEventListener("ready", function(e) {
   //console.log("Pebble ready");
   openmensaID = localStorage.getItem("openmensaID");
   //console.log("openmensaID:", openmensaID);
-  if (!openmensaID) {
-    Pebble.sendAppMessage({
+  if (canteenIDs().length === 0) {
+    enqueueMessage({
         "ERROR_MSG": "Please go into the settings and set your Canteen's ID"
-      }, function(e) {
-        //console.log("Error message sent");
-      }, function(e) {
-        console.log("Error message send failed", JSON.stringify(e));
-      });
+      }, "error");
     console.log("No openmensaID configured.");
     return;
   }
@@ -26,57 +554,245 @@ Pebble.addEventListener("ready", function(e) {
   fetchDayList();
 });
 
-function fetchDayList() {
-  // Fetch day list for the menu
-  var url = "https://openmensa.org/api/v2/canteens/" + openmensaID + "/days";
-  //console.log("Fetching days from: " + url);
-  
-  var req = new XMLHttpRequest();
-  req.onload = function() {
-    if (req.status >= 200 && req.status < 300) {
-      var data = JSON.parse(req.responseText);
-      var activeDates = data.filter(function(day) {
-        return day.closed === false;
-      }).map(function(day) {
-        return day.date;
-      });
-      if (activeDates.length > 10) { activeDates = activeDates.slice(0, 10); }
-      
-      // Reformat dates and compute weekdays.
-      var formattedDates = activeDates.map(function(dateStr) {
-        var parts = dateStr.split('-'); // [YYYY, MM, DD]
-        return parts[2] + '.' + parts[1] + '.' + parts[0];
-      });
-      
-      var weekdayNames = activeDates.map(function(dateStr) {
-        var parts = dateStr.split('-');
-        var dateObj = new Date(parts[0], parts[1] - 1, parts[2]);
-        return dateObj.toLocaleDateString('en-US', { weekday: 'short' });
-      });
-      
-      Pebble.sendAppMessage({
-        "DAY_LIST": JSON.stringify(formattedDates)
-      }, function(e) {
-        //console.log("DAY_LIST sent:", JSON.stringify(formattedDates));
-        Pebble.sendAppMessage({
-          "WEEKDAY_LIST": JSON.stringify(weekdayNames)
-        }, function(e) {
-          //console.log("WEEKDAY_LIST sent:", JSON.stringify(weekdayNames));
-        }, function(e) {
-          console.log("WEEKDAY_LIST send failed");
-        });
-      }, function(e) {
-        console.log("DAY_LIST send failed");
-      });
+var DAY_DATA_VERSION = 1;
+var MS_PER_DAY = 86400000;
+
+// Days since 1970-01-01 for an API date (YYYY-MM-DD), and back.
+function toDayNumber(apiDate) {
+  var parts = apiDate.split('-');
+  return Math.round(Date.UTC(parts[0], parts[1] - 1, parts[2]) / MS_PER_DAY);
+}
+
+function fromDayNumber(day) {
+  return new Date(day * MS_PER_DAY).toISOString().slice(0, 10);
+}
+
+// Packs the dates as DAY_DATA: [version][count] then [day:2 LE] per date.
+function encodeDays(apiDates) {
+  var bytes = [DAY_DATA_VERSION, apiDates.length];
+  apiDates.forEach(function(apiDate) {
+    var day = toDayNumber(apiDate);
+    bytes.push(day & 0xFF, (day >> 8) & 0xFF);
+  });
+  return bytes;
+}
+
+function toApiDate(dateObj) {
+  var month = ('0' + (dateObj.getMonth() + 1)).slice(-2);
+  var day = ('0' + dateObj.getDate()).slice(-2);
+  return dateObj.getFullYear() + '-' + month + '-' + day;
+}
+
+// Fetches the meals of one canteen on apiDate and calls callback(meals), or callback(null) on
+// failure. Answers from the meal store unless refresh is set, and falls back to it when the
+// request fails. Shares requests that are already in flight.
+// Urgent requests (the watch is waiting) jump the prefetch queue.
+function fetchMeals(canteen, apiDate, urgent, callback, refresh) {
+  var key = canteen + "/" + apiDate;
+  var stored = store.get(key);
+  if (stored && !refresh) {
+    if (callback) { callback(stored); }
+    return;
+  }
+  var pending = pendingMeals[key];
+  if (pending) {
+    if (callback) { pending.callbacks.push(callback); }
+    if (!urgent) { pending.onDemand = false; }
+    var queued = prefetchQueue.indexOf(key);
+    if (urgent && queued > 0) {
+      prefetchQueue.splice(queued, 1);
+      prefetchQueue.unshift(key);
+    }
+    return;
+  }
+  pendingMeals[key] = { callbacks: callback ? [callback] : [], xhr: null, onDemand: urgent };
+  if (urgent) {
+    prefetchQueue.unshift(key);
+  } else {
+    prefetchQueue.push(key);
+  }
+  runPrefetchQueue();
+}
+
+// Fetches apiDate from every configured canteen in parallel and calls callback(sections,
+// complete) once all have answered, with { canteen, meals } per canteen that serves meals that
+// day; complete is false if a canteen could not be fetched. After MEALS_FETCH_TIMEOUT it
+// answers with the canteens that have answered so far; the others still fill the store.
+function fetchAllMeals(apiDate, urgent, callback, refresh) {
+  var canteens = canteenIDs();
+  var results = [];
+  var remaining = canteens.length;
+  var failed = false;
+  var deadline = setTimeout(done, MEALS_FETCH_TIMEOUT);
+  function done() {
+    if (!callback) { return; }
+    clearTimeout(deadline);
+    var answer = callback;
+    callback = null;
+    answer(results.filter(function(result) { return result; }), !failed && remaining === 0);
+  }
+  canteens.forEach(function(canteen, index) {
+    fetchMeals(canteen, apiDate, urgent, function(meals) {
+      results[index] = meals && meals.length ? { canteen: canteen, meals: meals } : null;
+      failed = failed || !meals;
+      if (--remaining === 0) { done(); }
+    }, refresh);
+  });
+}
+
+// Aborts an on-demand request nobody needs anymore. Prefetches keep running to fill the cache.
+function cancelMeals(key) {
+  var pending = pendingMeals[key];
+  if (!pending || !pending.onDemand) { return; }
+  delete pendingMeals[key];
+  var queued = prefetchQueue.indexOf(key);
+  if (queued !== -1) {
+    prefetchQueue.splice(queued, 1);
+  } else if (pending.xhr) {
+    pending.xhr.abort();
+    activeFetches--;
+    runPrefetchQueue();
+  }
+}
+
+function runPrefetchQueue() {
+  while (activeFetches < MAX_CONCURRENT_FETCHES && prefetchQueue.length > 0) {
+    startMealsRequest(prefetchQueue.shift());
+  }
+}
+
+function startMealsRequest(key) {
+  var parts = key.split("/");
+  var canteen = parts[0];
+  var url = apiBaseUrl() + "/canteens/" + canteen + "/days/" + parts[1] + "/meals";
+  var reqMeals = new XMLHttpRequest();
+  var pending = pendingMeals[key];
+  pending.xhr = reqMeals;
+  activeFetches++;
+
+  function finish(meals) {
+    if (pendingMeals[key] !== pending) { return; }  // Cancelled.
+    activeFetches--;
+    // Drop results for a canteen that was removed in the settings meanwhile.
+    if (meals && canteenIDs().indexOf(canteen) !== -1) {
+      meals = store.put(key, meals);
+    }
+    delete pendingMeals[key];
+    var result = meals || store.get(key);
+    pending.callbacks.forEach(function(callback) { callback(result); });
+    runPrefetchQueue();
+  }
+
+  reqMeals.onload = function() {
+    if (reqMeals.status === 404) {
+      finish([]);  // The canteen has no meals listed for the day.
+    } else if (reqMeals.status >= 200 && reqMeals.status < 300) {
+      try {
+        finish(JSON.parse(reqMeals.responseText));
+      } catch(ex) {
+        console.log("Error parsing meals JSON:", ex);
+        finish(null);
+      }
     } else {
-      console.log("XHR request failed: " + req.status);
+      console.log("Meals request failed: " + reqMeals.statusText);
+      finish(null);
     }
   };
-  req.onerror = function() {
-    console.log("XHR network error");
+  reqMeals.onerror = function() {
+    console.log("Meals XHR network error");
+    finish(null);
   };
-  req.open("GET", url);
-  req.send();
+  reqMeals.ontimeout = function() {
+    console.log("Meals request timed out: " + key);
+    finish(null);
+  };
+  reqMeals.open("GET", url);
+  reqMeals.timeout = MEALS_FETCH_TIMEOUT;
+  reqMeals.send();
+}
+
+// Queues every open day of every canteen for prefetching, today and tomorrow first.
+function prefetchMeals(datesByCanteen, activeDates) {
+  var today = new Date();
+  var tomorrow = new Date(today.getFullYear(), today.getMonth(), today.getDate() + 1);
+  var first = [toApiDate(today), toApiDate(tomorrow)];
+  var ordered = activeDates.filter(function(date) { return first.indexOf(date) !== -1; })
+    .concat(activeDates.filter(function(date) { return first.indexOf(date) === -1; }));
+  ordered.forEach(function(date) {
+    canteenIDs().forEach(function(canteen) {
+      if (datesByCanteen[canteen].indexOf(date) !== -1) {
+        fetchMeals(canteen, date, false, null);
+      }
+    });
+  });
+}
+
+// Fetches the day lists of all canteens in parallel and sends the watch every day on which
+// at least one of them is open.
+function fetchDayList() {
+  // A newer day list request supersedes the previous one.
+  dayListRequests.forEach(function(req) { req.abort(); });
+  dayListRequests = [];
+
+  var canteens = canteenIDs();
+  var datesByCanteen = {};
+  var remaining = canteens.length;
+  function done() {
+    if (--remaining > 0) { return; }
+    dayListRequests = [];
+    var activeDates = [];
+    canteens.forEach(function(canteen) {
+      (datesByCanteen[canteen] || []).forEach(function(date) {
+        if (activeDates.indexOf(date) === -1) { activeDates.push(date); }
+      });
+    });
+    if (activeDates.length === 0) { return; }
+    // API dates sort chronologically as strings.
+    activeDates.sort();
+    if (activeDates.length > 10) { activeDates = activeDates.slice(0, 10); }
+    prefetchMeals(datesByCanteen, activeDates);
+
+    var hash = contentHash(JSON.stringify(activeDates));
+    if (hash === watchDaysHash) {
+      enqueueMessage({ "DAYS_NOT_MODIFIED": 1 }, "days");
+      return;
+    }
+    watchDaysHash = hash;
+    // The watch formats the date and weekday itself from the day numbers.
+    enqueueMessage({ "DAY_DATA": encodeDays(activeDates), "DAYS_HASH": hash }, "days");
+  }
+
+  canteens.forEach(function(canteen) {
+    if (canteens.length > 1) { fetchCanteenName(canteen); }
+    var url = apiBaseUrl() + "/canteens/" + canteen + "/days";
+    var req = new XMLHttpRequest();
+    dayListRequests.push(req);
+    req.onload = function() {
+      if (req.status >= 200 && req.status < 300) {
+        try {
+          datesByCanteen[canteen] = JSON.parse(req.responseText).filter(function(day) {
+            return day.closed === false;
+          }).map(function(day) {
+            return day.date;
+          });
+        } catch(ex) {
+          console.log("Error parsing days JSON:", ex);
+          datesByCanteen[canteen] = [];
+        }
+      } else {
+        console.log("XHR request failed: " + req.status);
+        datesByCanteen[canteen] = [];
+      }
+      done();
+    };
+    req.onerror = function() {
+      console.log("XHR network error");
+      datesByCanteen[canteen] = [];
+      done();
+    };
+    req.open("GET", url);
+    req.send();
+  });
 }
 
 Pebble.addEventListener("showConfiguration", function(e) {
@@ -88,110 +804,170 @@ Pebble.addEventListener("webviewclosed", function(e) {
   var settings = clay.getSettings(e.response);
   localStorage.setItem("openmensaID", settings[messageKeys.openmensaID]);
   openmensaID = settings[messageKeys.openmensaID];
+  store.clear();
+  lastSentByDay = {};
   localStorage.setItem("MEAL_PRICE", settings[messageKeys.MEAL_PRICE]);
-  Pebble.sendAppMessage({ "RELOAD_APP": 1 }, 
-    function(e) {
-      console.log("Reload message sent.");
-    }, 
-    function(e) {
-      console.log("Reload message send failed", JSON.stringify(e));
-    }
-  );
+  localStorage.setItem("DIET_LANGUAGES", settings[messageKeys.DIET_LANGUAGES] || "");
+  localStorage.setItem("API_BASE_URL", settings[messageKeys.API_BASE_URL] || "");
+  // The watch schedules its own wakeup; -1 turns the pre-warm off.
+  var prewarm = /^(\d{1,2}):(\d{2})/.exec(settings[messageKeys.PREWARM_TIME] || "");
+  enqueueMessage({ "PREWARM_TIME": prewarm ? prewarm[1] * 60 + Number(prewarm[2]) : -1 }, "prewarm");
+  enqueueMessage({ "RELOAD_APP": 1 }, "reload", function() {
+    console.log("Reload message sent.");
+  });
 });
 
+// Simplified meal list of one day, one section per canteen. A single canteen needs no header.
+function buildSections(results) {
+  var pricingCategory = localStorage.getItem("MEAL_PRICE") || "students";
+  var languages = diet.parseLanguages(localStorage.getItem("DIET_LANGUAGES"));
+  return results.map(function(result) {
+    return {
+      name: canteenIDs().length > 1 ? (canteenNames[result.canteen] || "Mensa " + result.canteen) : "",
+      meals: result.meals.map(function(meal) {
+        var attributes = diet.classifyMeal(meal, languages);
+        return {
+          id: meal.id,
+          name: attributes.name,
+          flags: attributes.flags,
+          price: meal.prices && meal.prices[pricingCategory] ? meal.prices[pricingCategory] : null
+        };
+      })
+    };
+  });
+}
+
+// Sends the meals of a day: "not modified" when the watch holds this content (watchHash), a
+// delta when it holds the complete list we sent last (watchRev), the first page otherwise.
+// Lists older than MEALS_REVALIDATE_AFTER are fetched again afterwards (refresh).
+function sendMealsForDay(selectedDay, apiDate, watchRev, watchHash, refresh) {
+  fetchAllMeals(apiDate, true, function(results, complete) {
+    // Latest selection wins; a slower answer for an earlier tap is dropped.
+    if (apiDate !== selectedApiDate) {
+      return;
+    }
+    if (results.length === 0) {
+      // Tell the watch instead of leaving the tap unanswered; it keeps a list it already shows.
+      // A failed refresh changes nothing on the watch.
+      if (!refresh) {
+        enqueueMessage({
+          "MEALS_UNAVAILABLE": complete ? MEALS_UNAVAILABLE_NONE : MEALS_UNAVAILABLE_FAILED,
+          "SELECTED_DAY": selectedDay
+        }, "meals");
+      }
+      return;
+    }
+
+    var sections = buildSections(results);
+    var rev = contentHash(JSON.stringify(sections));
+    if (rev === watchHash) {
+      lastSentByDay[selectedDay] = { rev: rev, sections: sections };
+      enqueueMessage({ "MEALS_NOT_MODIFIED": 1, "SELECTED_DAY": selectedDay, "MEALS_REV": rev }, "meals");
+      revalidate(results, rev, watchRev === rev);
+      return;
+    }
+    // Sync new dictionary words. Names only refer to entries once their transfer completed, so
+    // these meals still spell new words out; a dictionary transfer that fails costs nothing.
+    dictionary.learn(flattenSections(sections).map(function(meal) { return meal.name; }));
+    var dict = dictionary.syncPayload();
+    if (dict) {
+      sendChunked(XFER_KIND_DICT, dict, null, null, function() { dictionary.synced(dict); });
+    }
+    var full = encodeMeals(sections, firstPageSize());
+    var complete = flattenSections(sections).length <= firstPageSize();
+    var base = lastSentByDay[selectedDay];
+    var delta = base && base.rev === watchRev ? encodeMealsDelta(base, sections, full.length) : null;
+    lastSentByDay[selectedDay] = { rev: rev, sections: sections };
+    // Echo the day so the watch can file the meals in its persistent cache.
+    sendChunked(delta ? XFER_KIND_MEALS_DELTA : XFER_KIND_MEALS, delta || full, {
+      "SELECTED_DAY": selectedDay,
+      "MEALS_REV": rev
+    }, "meals");
+    // A watch short on memory drops pushed details anyway and asks per meal instead.
+    if (watchMemLevel < MEM_LEVEL_SHORT_NAMES) {
+      pushMealDetails([].concat.apply([], results.map(function(result) { return result.meals; })));
+    }
+
+    revalidate(results, rev, complete);
+  }, refresh);
+
+  // Fetches stored lists again once they are old; the answer goes out like a new selection
+  // against what the watch holds by then (complete: whether the whole list is on the watch).
+  // A failed refresh answers from the store again, so it is not retried right away.
+  function revalidate(results, rev, complete) {
+    var stale = !refresh && results.some(function(result) {
+      return Date.now() - store.fetchedAt(result.canteen + "/" + apiDate) > MEALS_REVALIDATE_AFTER;
+    });
+    if (stale) {
+      sendMealsForDay(selectedDay, apiDate, complete ? rev : 0, rev, true);
+    }
+  }
+}
+
+// Answers a MEALS_PAGE request from the list the watch holds, or resends the list if that
+// revision is gone.
+function sendMealPage(selectedDay, rev, first, count) {
+  var base = lastSentByDay[selectedDay];
+  if (!base || base.rev !== rev) {
+    var apiDate = fromDayNumber(selectedDay);
+    if (apiDate === selectedApiDate) {
+      sendMealsForDay(selectedDay, apiDate, 0, 0);
+    }
+    return;
+  }
+  var page = encodeMealPage(rev, flattenSections(base.sections), first, count);
+  sendChunked(XFER_KIND_MEALS_PAGE, page, { "SELECTED_DAY": selectedDay, "MEALS_REV": rev }, "page");
+}
+
 // Listen for messages from the watch.
 Pebble.addEventListener("appmessage", function(e) {
-  if (e.payload.RELOAD_DONE === 1) {
+  if (e.payload.XFER_CHUNK_SIZE) {
+    xferChunkSize = e.payload.XFER_CHUNK_SIZE;
+  }
+  // Sent at launch and with RELOAD_DONE; the watch starts with an empty detail cache.
+  if (e.payload.DAYS_HASH !== undefined) {
+    watchDaysHash = e.payload.DAYS_HASH;
+    pushedDetails = {};
+  }
+  if (e.payload.MEM_LEVEL !== undefined) {
+    watchMemLevel = e.payload.MEM_LEVEL;
+    if (watchMemLevel >= MEM_LEVEL_SHORT_NAMES) {
+      pushedDetails = {};  // The watch dropped its detail cache.
+    }
+    console.log("Watch memory level: " + watchMemLevel);
+  }
+  if (e.payload.DIAG_REPORT) {
+    console.log("Watch diagnostics:\n" + e.payload.DIAG_REPORT);
+  } else if (e.payload.XFER_ID !== undefined) {
+    handleTransferReply(e.payload);
+  } else if (e.payload.RELOAD_DONE === 1) {
     fetchDayList();
-  } else if (e.payload.SELECTED_DATE) {
-      var openmensaID = localStorage.getItem("openmensaID");
-      var parts = e.payload.SELECTED_DATE.split('.');
-      if(parts.length === 3) {
-        var apiDate = parts[2] + '-' + parts[1] + '-' + parts[0];
-        var url = "https://openmensa.org/api/v2/canteens/" + openmensaID + "/days/" + apiDate + "/meals";
-        //console.log("Fetching meals from: " + url);
-        var reqMeals = new XMLHttpRequest();
-        reqMeals.onload = function() {
-          if (reqMeals.status >= 200 && reqMeals.status < 300) {
-            try {
-              var fullMeals = JSON.parse(reqMeals.responseText);
-              // Cache the full meals JSON.
-              cachedMeals = fullMeals;
-
-              var pricingCategory = localStorage.getItem("MEAL_PRICE") || "students";
-              // Build the simplified objects.
-              var simplifiedMeals = fullMeals.map(function(meal) {
-                return {
-                  id: meal.id,
-                  name: meal.name,
-                  price: meal.prices && meal.prices[pricingCategory] ? meal.prices[pricingCategory] : null
-                };
-              });
-              // Create separate arrays.
-              var mealIDs = simplifiedMeals.map(function(meal) { return meal.id; });
-              var mealNames = simplifiedMeals.map(function(meal) { return meal.name; });
-              var MEAL_PRICES = simplifiedMeals.map(function(meal) { 
-                  return meal.price !== null ? meal.price.toFixed(2) + "€" : "N/A"; 
-                });
-              
-              // Combine into a single dictionary payload.
-              var payload = {
-                "MEALS_IDS": JSON.stringify(mealIDs),
-                "MEALS_NAMES": JSON.stringify(mealNames),
-                "MEALS_PRICES": JSON.stringify(MEAL_PRICES)
-              };
-
-              Pebble.sendAppMessage(payload, function(e) {
-                //console.log("Combined meals payload sent:", JSON.stringify(payload));
-              }, function(e) {
-                console.log("Combined meals payload send failed");
-              });
-            
-            } catch(ex) {
-              console.log("Error parsing meals JSON:", ex);
-            }
-          } else {
-            console.log("Meals request failed: " + reqMeals.statusText);
-          }
-        };
-        reqMeals.onerror = function() {
-          console.log("Meals XHR network error");
-        };
-        reqMeals.open("GET", url);
-        reqMeals.send();
+  } else if (e.payload.MEALS_PAGE !== undefined) {
+    sendMealPage(e.payload.SELECTED_DAY, e.payload.MEALS_REV, e.payload.MEALS_PAGE, e.payload.MEALS_PAGE_COUNT);
+  } else if (e.payload.SELECTED_DAY) {
+      var selectedDay = e.payload.SELECTED_DAY;
+      var apiDate = fromDayNumber(selectedDay);
+      if (selectedApiDate && selectedApiDate !== apiDate) {
+        canteenIDs().forEach(function(canteen) {
+          cancelMeals(canteen + "/" + selectedApiDate);
+        });
       }
+      selectedApiDate = apiDate;
+      dictionary.setWatchState(e.payload);
+      sendMealsForDay(selectedDay, apiDate, e.payload.MEALS_REV || 0, e.payload.MEALS_HASH || 0);
   }
-  // If a meal was selected on the watch, look it up in the cache and send back the meal info.
+  // If a meal was selected on the watch, look it up in the store and send back the meal info.
   else if (e.payload.MEAL_ID !== undefined) {
-    if (!cachedMeals) {
-      //console.log("No cached meals available.");
-      return;
-    }
     var selectedMealId = e.payload.MEAL_ID;
-    // Find the meal in the cached meals using the meal id.
-    var mealInfo = cachedMeals.find(function(meal) {
-      return meal.id === selectedMealId;
-    });
+    var mealInfo = store.meal(selectedMealId);
     if (mealInfo) {
-      var pricingCategory = localStorage.getItem("MEAL_PRICE") || "students";
-      var singlePrice = (mealInfo.prices && mealInfo.prices[pricingCategory]) ?
-                           mealInfo.prices[pricingCategory].toFixed(2) + "€" : "N/A";
-      var notes = ""
-      mealInfo.notes.forEach(function(note) {
-        notes += note + ", ";
-      });
-      //remove trailing comma
-      notes = notes.replace(/,\s*$/, "");
+      var detail = mealDetail(mealInfo);
       var payload = {
-        "MEAL_NAME": mealInfo.name,
-        "MEAL_PRICE": singlePrice,
-        "MEAL_NOTES": notes
+        "MEAL_NAME": detail.name,
+        "MEAL_PRICE": detail.price,
+        "MEAL_NOTES": encodeNotes(mealInfo.notes || [], messageNotesBudget(detail))
       };
-      Pebble.sendAppMessage(payload, function(e) {
-        //console.log("Single meal payload sent:", JSON.stringify(payload));
-      }, function(e) {
-        console.log("Single meal payload send failed");
-      });
+      enqueueMessage(payload, "detail");
     } else {
       console.log("Meal not found for id:", selectedMealId);
     }
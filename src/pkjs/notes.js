@@ -0,0 +1,27 @@
+// Codes for the known OpenMensa note strings. The watch holds the same strings as the
+// NOTE_TABLE resource, which tools/note_table.py compiles from notes.json, so only the code is
+// sent.
+var TABLE = require('./notes.json');
+
+// Note code that introduces an inline string; must match NOTE_LITERAL in OpenMensa.c.
+var LITERAL = 0xFF;
+
+function normalize(note) {
+  return note.trim().toLowerCase();
+}
+
+var codes = {};
+TABLE.forEach(function(note, index) {
+  codes[normalize(note)] = index;
+});
+
+// Returns the table index of note, or LITERAL when it has to be sent as text.
+function codeFor(note) {
+  var code = codes[normalize(note)];
+  return code === undefined ? LITERAL : code;
+}
+
+module.exports = {
+  LITERAL: LITERAL,
+  codeFor: codeFor
+};
@@ -0,0 +1,169 @@
+// Meals per canteen and date ("ID/YYYY-MM-DD"), kept in localStorage so the watch can be
+// answered without the network after the phone app was stopped. Days and meal ids are hash
+// indexed; the stored form only keeps the fields the watch needs.
+//
+// The store is held to MAX_BYTES of JSON. Past dates go first, then the least recently used.
+var STORAGE_KEY = "mealStore";
+var VERSION = 1;
+var MAX_BYTES = 64 * 1024;
+var SAVE_DELAY = 1000;  // ms; a prefetch run stores many days in a row.
+
+var days = {};   // key -> { meals, fetchedAt, usedAt, bytes }
+var byId = {};   // meal id -> { key, meal }
+var totalBytes = 0;
+var saveTimer = null;
+
+function today() {
+  var now = new Date();
+  return now.getFullYear() + '-' + ('0' + (now.getMonth() + 1)).slice(-2) + '-' + ('0' + now.getDate()).slice(-2);
+}
+
+function isPast(key) {
+  return key.split("/")[1] < today();
+}
+
+// Stored form of a meal: [id, name, category, notes, prices].
+function pack(meal) {
+  return [meal.id, meal.name, meal.category || "", meal.notes || [], meal.prices || {}];
+}
+
+function unpack(packed) {
+  return { id: packed[0], name: packed[1], category: packed[2], notes: packed[3], prices: packed[4] };
+}
+
+function packDay(day) {
+  return [day.fetchedAt, day.usedAt, day.meals.map(pack)];
+}
+
+function index(key, day) {
+  day.meals.forEach(function(meal) {
+    byId[meal.id] = { key: key, meal: meal };
+  });
+}
+
+function remove(key) {
+  var day = days[key];
+  if (!day) { return; }
+  day.meals.forEach(function(meal) {
+    var entry = byId[meal.id];
+    if (entry && entry.key === key) {
+      delete byId[meal.id];
+    }
+  });
+  totalBytes -= day.bytes;
+  delete days[key];
+  scheduleSave();
+}
+
+// Evicts past dates, then the least recently used days, until bytes more fit the budget.
+function makeRoom(bytes) {
+  Object.keys(days).filter(isPast).forEach(remove);
+  while (totalBytes + bytes > MAX_BYTES) {
+    var oldest = null;
+    for (var key in days) {
+      if (!oldest || days[key].usedAt < days[oldest].usedAt) { oldest = key; }
+    }
+    if (!oldest) { return; }
+    remove(oldest);
+  }
+}
+
+function scheduleSave() {
+  if (saveTimer) { return; }
+  saveTimer = setTimeout(save, SAVE_DELAY);
+}
+
+function save() {
+  clearTimeout(saveTimer);
+  saveTimer = null;
+  var stored = { version: VERSION, days: {} };
+  for (var key in days) {
+    stored.days[key] = packDay(days[key]);
+  }
+  try {
+    localStorage.setItem(STORAGE_KEY, JSON.stringify(stored));
+  } catch (err) {
+    console.log("Could not save the meal store: " + err);
+  }
+}
+
+// Loads the stored days and compacts them: past dates are dropped and the rest is fitted
+// to the budget, most recently used first.
+function load() {
+  var stored = null;
+  try {
+    stored = JSON.parse(localStorage.getItem(STORAGE_KEY) || "null");
+  } catch (err) {
+    console.log("Dropping unreadable meal store: " + err);
+  }
+  if (!stored || stored.version !== VERSION) {
+    localStorage.removeItem(STORAGE_KEY);
+    return;
+  }
+  var keys = Object.keys(stored.days).filter(function(key) { return !isPast(key); });
+  keys.sort(function(a, b) { return stored.days[b][1] - stored.days[a][1]; });
+  keys.forEach(function(key) {
+    var packed = stored.days[key];
+    var bytes = JSON.stringify(packed).length;
+    if (totalBytes + bytes > MAX_BYTES) { return; }
+    var day = { fetchedAt: packed[0], usedAt: packed[1], meals: packed[2].map(unpack), bytes: bytes };
+    days[key] = day;
+    totalBytes += bytes;
+    index(key, day);
+  });
+  if (keys.length !== Object.keys(stored.days).length) {
+    scheduleSave();
+  }
+}
+
+// Returns the meals stored for key, or null. The use is saved too, so the next launch
+// keeps the days that were looked at most recently.
+function get(key) {
+  var day = days[key];
+  if (!day) { return null; }
+  day.usedAt = Date.now();
+  scheduleSave();
+  return day.meals;
+}
+
+function put(key, meals) {
+  remove(key);
+  var day = { fetchedAt: Date.now(), usedAt: Date.now(), meals: meals.map(function(meal) { return unpack(pack(meal)); }) };
+  day.bytes = JSON.stringify(packDay(day)).length;
+  makeRoom(day.bytes);
+  if (day.bytes > MAX_BYTES) { return day.meals; }
+  days[key] = day;
+  totalBytes += day.bytes;
+  index(key, day);
+  scheduleSave();
+  return day.meals;
+}
+
+// Time the meals for key were fetched, or 0.
+function fetchedAt(key) {
+  return days[key] ? days[key].fetchedAt : 0;
+}
+
+// Returns the meal with the given id from any stored day, or undefined.
+function meal(id) {
+  var entry = byId[id];
+  return entry && entry.meal;
+}
+
+function clear() {
+  days = {};
+  byId = {};
+  totalBytes = 0;
+  save();
+}
+
+load();
+
+module.exports = {
+  get: get,
+  put: put,
+  remove: remove,
+  fetchedAt: fetchedAt,
+  meal: meal,
+  clear: clear
+};
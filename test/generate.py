@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""
+Writes the headers the Pebble SDK would generate for a host build of OpenMensa.c:
+platform_profile.h from PLATFORM_PROFILES in the wscript, and message_keys.h with the
+MESSAGE_KEY_* and RESOURCE_ID_* values from package.json.
+
+    generate.py OUT_DIR PLATFORM
+"""
+import json
+import os
+import runpy
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+
+
+def write_if_changed(path, content):
+    if os.path.exists(path):
+        with open(path) as f:
+            if f.read() == content:
+                return
+    with open(path, 'w') as f:
+        f.write(content)
+
+
+def message_keys_header():
+    with open(os.path.join(ROOT, 'package.json')) as f:
+        pebble = json.load(f)['pebble']
+    lines = ['// Generated by test/generate.py from package.json.', '#pragma once', '']
+    keys = []
+    for key in pebble['messageKeys']:
+        name = key.split('[')[0]
+        if name not in keys:
+            keys.append(name)
+    for index, name in enumerate(keys):
+        lines.append('#define MESSAGE_KEY_{} {}'.format(name, 10000 + index))
+    lines.append('')
+    files = []
+    for index, media in enumerate(pebble['resources']['media'], 1):
+        lines.append('#define RESOURCE_ID_{} {}'.format(media['name'], index))
+        files.append('  [{}] = "{}", \\'.format(index, media['file']))
+    lines.append('')
+    lines.append('// Resource files relative to resources/, by resource id.')
+    lines.append('#define SHIM_RESOURCE_FILES { \\')
+    lines.extend(files)
+    lines.append('}')
+    return '\n'.join(lines) + '\n'
+
+
+def main():
+    out_dir, platform = sys.argv[1], sys.argv[2]
+    os.makedirs(out_dir, exist_ok=True)
+    wscript = runpy.run_path(os.path.join(ROOT, 'wscript'))
+    write_if_changed(os.path.join(out_dir, 'platform_profile.h'), wscript['platform_profile_header'](platform))
+    write_if_changed(os.path.join(out_dir, 'message_keys.h'), message_keys_header())
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,378 @@
+// Minimal stand-in for the Pebble SDK's pebble.h, so src/c/OpenMensa.c builds and runs on the
+// host (see test/Makefile). Only the API the app uses is declared. Persistent storage, the
+// AppMessage boxes, timers, windows and the menu layer are simulated in memory by
+// pebble_shim.c; drawing and text layout are stubs with a fixed glyph size. The shim_*
+// declarations at the end let the tests drive the simulation and read its counters.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <time.h>
+
+#include "message_keys.h"  // MESSAGE_KEY_* and RESOURCE_ID_*, generated from package.json.
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define SECONDS_PER_DAY 86400
+#define PERSIST_DATA_MAX_LENGTH 256
+#define MENU_CELL_BASIC_HEADER_HEIGHT 16
+
+// --- Logging ---
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200,
+  APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+#define APP_LOG(level, fmt, args...) app_log(level, __FILE__, __LINE__, fmt, ## args)
+
+// --- Status codes ---
+typedef int32_t status_t;
+#define S_SUCCESS 0
+#define E_ERROR (-1)
+#define E_INVALID_ARGUMENT (-4)
+#define E_OUT_OF_MEMORY (-5)
+#define E_OUT_OF_STORAGE (-6)
+#define E_RANGE (-8)
+#define E_DOES_NOT_EXIST (-9)
+
+// --- Geometry and graphics ---
+typedef struct { int16_t x, y; } GPoint;
+typedef struct { int16_t w, h; } GSize;
+typedef struct { GPoint origin; GSize size; } GRect;
+#define GPoint(x, y) ((GPoint){ (x), (y) })
+#define GSize(w, h) ((GSize){ (w), (h) })
+#define GRect(x, y, w, h) ((GRect){ { (x), (y) }, { (w), (h) } })
+
+typedef union { uint8_t argb; } GColor;
+#define GColorWhite ((GColor){ 0xFF })
+#define GColorBlack ((GColor){ 0xC0 })
+
+typedef enum { GCompOpAssign, GCompOpAssignInverted, GCompOpOr, GCompOpAnd, GCompOpClear, GCompOpSet } GCompOp;
+typedef enum { GTextOverflowModeWordWrap, GTextOverflowModeTrailingEllipsis, GTextOverflowModeFill } GTextOverflowMode;
+typedef enum { GTextAlignmentLeft, GTextAlignmentCenter, GTextAlignmentRight } GTextAlignment;
+
+typedef struct GTextAttributes GTextAttributes;
+typedef struct GContext GContext;
+typedef struct GBitmap GBitmap;
+typedef const struct ShimFont *GFont;
+
+#define FONT_KEY_GOTHIC_14 "RESOURCE_ID_GOTHIC_14"
+#define FONT_KEY_GOTHIC_14_BOLD "RESOURCE_ID_GOTHIC_14_BOLD"
+#define FONT_KEY_GOTHIC_18 "RESOURCE_ID_GOTHIC_18"
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_GOTHIC_24_BOLD "RESOURCE_ID_GOTHIC_24_BOLD"
+
+GFont fonts_get_system_font(const char *font_key);
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id);
+void gbitmap_destroy(GBitmap *bitmap);
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect);
+void graphics_draw_text(GContext *ctx, const char *text, const GFont font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes *text_attributes);
+GSize graphics_text_layout_get_content_size(const char *text, const GFont font, const GRect box,
+                                            const GTextOverflowMode overflow_mode,
+                                            const GTextAlignment alignment);
+
+// --- Resources ---
+typedef const void *ResHandle;
+ResHandle resource_get_handle(uint32_t resource_id);
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes);
+
+// --- Layers and windows ---
+typedef struct Layer Layer;
+typedef struct Window Window;
+typedef struct TextLayer TextLayer;
+typedef struct ScrollLayer ScrollLayer;
+typedef struct MenuLayer MenuLayer;
+
+typedef enum { BUTTON_ID_BACK, BUTTON_ID_UP, BUTTON_ID_SELECT, BUTTON_ID_DOWN, NUM_BUTTONS } ButtonId;
+typedef void *ClickRecognizerRef;
+typedef void (*ClickHandler)(ClickRecognizerRef recognizer, void *context);
+typedef void (*ClickConfigProvider)(void *context);
+
+typedef void (*WindowHandler)(Window *window);
+typedef struct {
+  WindowHandler load;
+  WindowHandler appear;
+  WindowHandler disappear;
+  WindowHandler unload;
+} WindowHandlers;
+
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_add_child(Layer *parent, Layer *child);
+GRect layer_get_bounds(const Layer *layer);
+void layer_mark_dirty(Layer *layer);
+
+Window *window_create(void);
+void window_destroy(Window *window);
+Layer *window_get_root_layer(const Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider);
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler);
+void window_stack_push(Window *window, bool animated);
+bool window_stack_remove(Window *window, bool animated);
+void window_stack_pop_all(const bool animated);
+bool window_stack_contains_window(Window *window);
+
+TextLayer *text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer *text_layer);
+Layer *text_layer_get_layer(TextLayer *text_layer);
+void text_layer_set_text(TextLayer *text_layer, const char *text);
+void text_layer_set_font(TextLayer *text_layer, GFont font);
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment);
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode);
+
+typedef struct {
+  ClickConfigProvider click_config_provider;
+  void (*content_offset_changed_handler)(ScrollLayer *scroll_layer, void *context);
+} ScrollLayerCallbacks;
+
+ScrollLayer *scroll_layer_create(GRect frame);
+void scroll_layer_destroy(ScrollLayer *scroll_layer);
+Layer *scroll_layer_get_layer(const ScrollLayer *scroll_layer);
+void scroll_layer_add_child(ScrollLayer *scroll_layer, Layer *child);
+void scroll_layer_set_callbacks(ScrollLayer *scroll_layer, ScrollLayerCallbacks callbacks);
+void scroll_layer_set_click_config_onto_window(ScrollLayer *scroll_layer, Window *window);
+void scroll_layer_set_content_size(ScrollLayer *scroll_layer, GSize size);
+
+// --- Menu layer ---
+typedef struct {
+  uint16_t section;
+  uint16_t row;
+} MenuIndex;
+#define MenuIndex(section, row) ((MenuIndex){ (section), (row) })
+
+typedef enum { MenuRowAlignNone, MenuRowAlignCenter, MenuRowAlignTop, MenuRowAlignBottom } MenuRowAlign;
+
+typedef uint16_t (*MenuLayerGetNumberOfSectionsCallback)(MenuLayer *menu_layer, void *callback_context);
+typedef uint16_t (*MenuLayerGetNumberOfRowsInSectionsCallback)(MenuLayer *menu_layer, uint16_t section_index,
+                                                               void *callback_context);
+typedef int16_t (*MenuLayerGetCellHeightCallback)(MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+typedef int16_t (*MenuLayerGetHeaderHeightCallback)(MenuLayer *menu_layer, uint16_t section_index,
+                                                    void *callback_context);
+typedef void (*MenuLayerDrawRowCallback)(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index,
+                                         void *callback_context);
+typedef void (*MenuLayerDrawHeaderCallback)(GContext *ctx, const Layer *cell_layer, uint16_t section_index,
+                                            void *callback_context);
+typedef void (*MenuLayerSelectCallback)(MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+typedef void (*MenuLayerSelectionChangedCallback)(MenuLayer *menu_layer, MenuIndex new_index, MenuIndex old_index,
+                                                  void *callback_context);
+
+typedef struct {
+  MenuLayerGetNumberOfSectionsCallback get_num_sections;
+  MenuLayerGetNumberOfRowsInSectionsCallback get_num_rows;
+  MenuLayerGetCellHeightCallback get_cell_height;
+  MenuLayerGetHeaderHeightCallback get_header_height;
+  MenuLayerDrawRowCallback draw_row;
+  MenuLayerDrawHeaderCallback draw_header;
+  MenuLayerSelectCallback select_click;
+  MenuLayerSelectCallback select_long_click;
+  MenuLayerSelectionChangedCallback selection_changed;
+} MenuLayerCallbacks;
+
+MenuLayer *menu_layer_create(GRect frame);
+void menu_layer_destroy(MenuLayer *menu_layer);
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer);
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks);
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, Window *window);
+void menu_layer_reload_data(MenuLayer *menu_layer);
+MenuIndex menu_layer_get_selected_index(const MenuLayer *menu_layer);
+void menu_layer_set_selected_index(MenuLayer *menu_layer, MenuIndex index, MenuRowAlign scroll_align, bool animated);
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title, const char *subtitle,
+                          GBitmap *icon);
+void menu_cell_basic_header_draw(GContext *ctx, const Layer *cell_layer, const char *title);
+bool menu_cell_layer_is_highlighted(const Layer *cell_layer);
+
+// --- Dictionaries and AppMessage ---
+typedef enum {
+  TUPLE_BYTE_ARRAY = 0,
+  TUPLE_CSTRING = 1,
+  TUPLE_UINT = 2,
+  TUPLE_INT = 3,
+} TupleType;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t key;
+  TupleType type:8;
+  uint16_t length;
+  union {
+    uint8_t data[0];
+    char cstring[0];
+    uint8_t uint8;
+    uint16_t uint16;
+    uint32_t uint32;
+    int8_t int8;
+    int16_t int16;
+    int32_t int32;
+  } value[];
+} Tuple;
+
+// Tuples packed back to back in buffer; unlike the SDK's iterator it owns no cursor.
+typedef struct DictionaryIterator {
+  uint8_t *buffer;
+  size_t size;
+  size_t used;
+} DictionaryIterator;
+
+typedef enum {
+  DICT_OK = 0,
+  DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+  DICT_INVALID_ARGS = 1 << 2,
+} DictionaryResult;
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *data, const uint16_t size);
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char *cstring);
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer,
+                                const uint8_t width_bytes, const bool is_signed);
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value);
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value);
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value);
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value);
+uint32_t dict_write_end(DictionaryIterator *iter);
+
+typedef enum {
+  APP_MSG_OK = 0,
+  APP_MSG_SEND_TIMEOUT = 1 << 1,
+  APP_MSG_SEND_REJECTED = 1 << 2,
+  APP_MSG_NOT_CONNECTED = 1 << 3,
+  APP_MSG_BUSY = 1 << 6,
+  APP_MSG_BUFFER_OVERFLOW = 1 << 7,
+  APP_MSG_OUT_OF_MEMORY = 1 << 12,
+} AppMessageResult;
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageInboxDropped)(AppMessageResult reason, void *context);
+typedef void (*AppMessageOutboxSent)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator *iterator, AppMessageResult reason, void *context);
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+uint32_t app_message_inbox_size_maximum(void);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback);
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback);
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback);
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback);
+
+// --- Storage ---
+bool persist_exists(const uint32_t key);
+status_t persist_delete(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+int32_t persist_read_int(const uint32_t key);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+status_t persist_write_int(const uint32_t key, const int32_t value);
+
+// --- Timers, time and wakeups ---
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+void app_timer_cancel(AppTimer *timer_handle);
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+typedef enum { TODAY = 0, SUNDAY, MONDAY, TUESDAY, WEDNESDAY, THURSDAY, FRIDAY, SATURDAY } WeekDay;
+time_t clock_to_timestamp(WeekDay day, int hour, int minute);
+
+typedef int32_t WakeupId;
+typedef void (*WakeupHandler)(WakeupId wakeup_id, int32_t cookie);
+WakeupId wakeup_schedule(time_t timestamp, int32_t cookie, bool notify_if_missed);
+void wakeup_cancel_all(void);
+void wakeup_service_subscribe(WakeupHandler handler);
+
+typedef enum {
+  APP_LAUNCH_SYSTEM,
+  APP_LAUNCH_USER,
+  APP_LAUNCH_PHONE,
+  APP_LAUNCH_WAKEUP,
+} AppLaunchReason;
+AppLaunchReason launch_reason(void);
+
+// --- Heap ---
+size_t heap_bytes_free(void);
+size_t heap_bytes_used(void);
+
+void app_event_loop(void);
+
+// --- Host test controls ---
+// The app's allocations go through a counting allocator that models the app heap.
+void *shim_malloc(size_t size);
+void shim_free(void *ptr);
+#ifndef PEBBLE_SHIM_IMPLEMENTATION
+#define malloc(size) shim_malloc(size)
+#define free(ptr) shim_free(ptr)
+#endif
+
+typedef struct {
+  size_t heap_size;        // Modelled app heap; heap_bytes_free() is heap_size minus used.
+  size_t used;
+  size_t peak;
+  uint32_t allocations;
+  int32_t fail_after;      // Allocations to allow before failing them; -1 never fails.
+} ShimHeap;
+extern ShimHeap shim_heap;
+void shim_heap_reset_peak(void);
+
+typedef struct {
+  size_t capacity;         // Bytes of values the storage holds; writes past it fail.
+  int32_t fail_after;      // Writes to allow before failing them; -1 never fails.
+  uint32_t writes;
+} ShimPersist;
+extern ShimPersist shim_persist;
+void shim_persist_clear(void);
+size_t shim_persist_used(void);
+
+// Outbox: a sent message stays in flight, keeping the outbox busy, until delivered.
+#define SHIM_MAX_SENT 64
+typedef struct {
+  uint8_t buffer[1024];
+  DictionaryIterator iter;
+} ShimMessage;
+extern ShimMessage shim_sent[SHIM_MAX_SENT];
+extern int shim_sent_count;
+extern uint32_t shim_outbox_size;
+bool shim_outbox_in_flight(void);
+void shim_outbox_deliver(bool success);
+void shim_outbox_reset(void);
+const DictionaryIterator *shim_last_sent(void);
+
+// Builds an inbound message in buffer and hands it to the registered inbox handler.
+void shim_dict_begin(DictionaryIterator *iter, uint8_t *buffer, size_t size);
+void shim_inbox_deliver(DictionaryIterator *iter);
+
+extern uint32_t shim_now_ms;
+void shim_advance(uint32_t ms);
+
+extern AppLaunchReason shim_launch_reason;
+extern const char *shim_resource_dir;
+extern bool shim_verbose;
+
+// Text layout: every glyph is SHIM_GLYPH_WIDTH wide and lines are the font size + 4 high.
+#define SHIM_GLYPH_WIDTH 8
+extern uint32_t shim_text_layouts;  // graphics_text_layout_get_content_size() calls.
+extern uint32_t shim_rows_drawn;
+
+Window *shim_window_top(void);
+int shim_window_count(void);
+// Draws the visible part of every dirty menu layer like the compositor does after a frame.
+void shim_render(void);
+// Layer of the meals menu and friends, by creation order.
+MenuLayer *shim_menu_layer(int index);
+void shim_menu_select(MenuLayer *menu_layer, MenuIndex index);
+void shim_menu_click(MenuLayer *menu_layer);
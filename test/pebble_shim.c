@@ -0,0 +1,857 @@
+// In-memory simulation of the parts of the Pebble SDK declared in test/pebble.h.
+#define PEBBLE_SHIM_IMPLEMENTATION
+#include <pebble.h>
+
+#include <stdarg.h>
+
+ShimHeap shim_heap = { .heap_size = 64 * 1024, .fail_after = -1 };
+ShimPersist shim_persist = { .capacity = 4096, .fail_after = -1 };
+ShimMessage shim_sent[SHIM_MAX_SENT];
+int shim_sent_count = 0;
+uint32_t shim_outbox_size = 0;
+uint32_t shim_now_ms = 0;
+AppLaunchReason shim_launch_reason = APP_LAUNCH_USER;
+const char *shim_resource_dir = "resources";
+bool shim_verbose = false;
+uint32_t shim_text_layouts = 0;
+uint32_t shim_rows_drawn = 0;
+
+// --- Logging ---
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+  if (!shim_verbose) {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "[%d] %s:%d: ", log_level, src_filename, src_line_number);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+// --- Heap ---
+typedef union {
+  size_t size;
+  long double align;
+  void *pointer;
+} ShimBlock;
+
+void *shim_malloc(size_t size) {
+  if (shim_heap.fail_after == 0 || shim_heap.used + size > shim_heap.heap_size) {
+    return NULL;
+  }
+  if (shim_heap.fail_after > 0) {
+    shim_heap.fail_after--;
+  }
+  ShimBlock *block = malloc(sizeof(ShimBlock) + size);
+  if (!block) {
+    return NULL;
+  }
+  block->size = size;
+  shim_heap.used += size;
+  shim_heap.allocations++;
+  if (shim_heap.used > shim_heap.peak) {
+    shim_heap.peak = shim_heap.used;
+  }
+  return block + 1;
+}
+
+void shim_free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  ShimBlock *block = (ShimBlock *)ptr - 1;
+  shim_heap.used -= block->size;
+  free(block);
+}
+
+void shim_heap_reset_peak(void) {
+  shim_heap.peak = shim_heap.used;
+}
+
+size_t heap_bytes_free(void) {
+  return shim_heap.used < shim_heap.heap_size ? shim_heap.heap_size - shim_heap.used : 0;
+}
+
+size_t heap_bytes_used(void) {
+  return shim_heap.used;
+}
+
+// --- Storage ---
+#define SHIM_PERSIST_KEYS 128
+static struct {
+  bool used;
+  uint32_t key;
+  uint16_t size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} s_persist[SHIM_PERSIST_KEYS];
+
+void shim_persist_clear(void) {
+  memset(s_persist, 0, sizeof(s_persist));
+  shim_persist.writes = 0;
+}
+
+size_t shim_persist_used(void) {
+  size_t used = 0;
+  for (int i = 0; i < SHIM_PERSIST_KEYS; i++) {
+    used += s_persist[i].used ? s_persist[i].size : 0;
+  }
+  return used;
+}
+
+static int persist_find(uint32_t key) {
+  for (int i = 0; i < SHIM_PERSIST_KEYS; i++) {
+    if (s_persist[i].used && s_persist[i].key == key) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool persist_exists(const uint32_t key) {
+  return persist_find(key) >= 0;
+}
+
+status_t persist_delete(const uint32_t key) {
+  int i = persist_find(key);
+  if (i < 0) {
+    return E_DOES_NOT_EXIST;
+  }
+  s_persist[i].used = false;
+  return S_SUCCESS;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  int i = persist_find(key);
+  if (i < 0) {
+    return E_DOES_NOT_EXIST;
+  }
+  size_t size = MIN(buffer_size, s_persist[i].size);
+  memcpy(buffer, s_persist[i].data, size);
+  return size;
+}
+
+int32_t persist_read_int(const uint32_t key) {
+  int32_t value = 0;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  if (size > PERSIST_DATA_MAX_LENGTH) {
+    return E_INVALID_ARGUMENT;
+  }
+  if (shim_persist.fail_after == 0) {
+    return E_OUT_OF_STORAGE;
+  }
+  int i = persist_find(key);
+  size_t replaced = i >= 0 ? s_persist[i].size : 0;
+  if (shim_persist_used() - replaced + size > shim_persist.capacity) {
+    return E_OUT_OF_STORAGE;
+  }
+  if (i < 0) {
+    for (i = 0; i < SHIM_PERSIST_KEYS && s_persist[i].used; i++) {
+    }
+    if (i == SHIM_PERSIST_KEYS) {
+      return E_OUT_OF_STORAGE;
+    }
+  }
+  if (shim_persist.fail_after > 0) {
+    shim_persist.fail_after--;
+  }
+  s_persist[i].used = true;
+  s_persist[i].key = key;
+  s_persist[i].size = size;
+  memcpy(s_persist[i].data, data, size);
+  shim_persist.writes++;
+  return size;
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+// --- Resources ---
+static const char *const s_resource_files[] = SHIM_RESOURCE_FILES;
+#define SHIM_RESOURCES (sizeof(s_resource_files) / sizeof(s_resource_files[0]))
+static struct {
+  uint32_t id;
+  uint8_t *data;
+  size_t size;
+  bool loaded;
+} s_resources[SHIM_RESOURCES];
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+  if (resource_id >= SHIM_RESOURCES || !s_resource_files[resource_id]) {
+    return NULL;
+  }
+  s_resources[resource_id].id = resource_id;
+  if (!s_resources[resource_id].loaded) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", shim_resource_dir, s_resource_files[resource_id]);
+    FILE *file = fopen(path, "rb");
+    if (file) {
+      fseek(file, 0, SEEK_END);
+      long size = ftell(file);
+      fseek(file, 0, SEEK_SET);
+      s_resources[resource_id].data = malloc(size > 0 ? size : 1);
+      s_resources[resource_id].size = fread(s_resources[resource_id].data, 1, size, file);
+      fclose(file);
+    }
+    s_resources[resource_id].loaded = true;
+  }
+  return &s_resources[resource_id];
+}
+
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes) {
+  const __typeof__(s_resources[0]) *resource = h;
+  if (!resource || start_offset >= resource->size) {
+    return 0;
+  }
+  size_t size = MIN(num_bytes, resource->size - start_offset);
+  memcpy(buffer, resource->data + start_offset, size);
+  return size;
+}
+
+// --- Graphics ---
+struct ShimFont {
+  int size;
+};
+struct GBitmap {
+  uint32_t resource_id;
+};
+struct GContext {
+  GColor text_color;
+};
+
+static const struct ShimFont s_fonts[] = { { 14 }, { 18 }, { 24 } };
+
+GFont fonts_get_system_font(const char *font_key) {
+  if (strstr(font_key, "14")) return &s_fonts[0];
+  if (strstr(font_key, "18")) return &s_fonts[1];
+  return &s_fonts[2];
+}
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  if (!resource_get_handle(resource_id)) {
+    return NULL;
+  }
+  GBitmap *bitmap = malloc(sizeof(GBitmap));
+  bitmap->resource_id = resource_id;
+  return bitmap;
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  free(bitmap);
+}
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+  ctx->text_color = color;
+}
+
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, const GFont font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes *text_attributes) {
+}
+
+// Wraps text at SHIM_GLYPH_WIDTH per UTF-8 character and cuts it to the lines that fit box.
+GSize graphics_text_layout_get_content_size(const char *text, const GFont font, const GRect box,
+                                            const GTextOverflowMode overflow_mode,
+                                            const GTextAlignment alignment) {
+  shim_text_layouts++;
+  int chars = 0;
+  for (const char *ptr = text; ptr && *ptr; ptr++) {
+    chars += ((uint8_t)*ptr & 0xC0) != 0x80;
+  }
+  if (chars == 0) {
+    return GSize(0, 0);
+  }
+  int per_line = MAX(1, box.size.w / SHIM_GLYPH_WIDTH);
+  int line_height = font->size + 4;
+  int lines = (chars + per_line - 1) / per_line;
+  lines = MAX(1, MIN(lines, box.size.h / line_height));
+  return GSize(MIN(chars, per_line) * SHIM_GLYPH_WIDTH, lines * line_height);
+}
+
+// --- Layers and windows ---
+struct Layer {
+  GRect bounds;
+  bool dirty;
+  bool highlighted;
+  LayerUpdateProc update_proc;
+};
+
+struct Window {
+  Layer root;
+  WindowHandlers handlers;
+  bool loaded;
+};
+
+struct TextLayer {
+  Layer layer;
+  const char *text;
+};
+
+struct ScrollLayer {
+  Layer layer;
+};
+
+#define SHIM_SCREEN GRect(0, 0, 144, 168)
+#define SHIM_STACK_DEPTH 16
+static Window *s_stack[SHIM_STACK_DEPTH];
+static int s_stack_count = 0;
+
+// Plain layers are drawn after every menu, as if they were added above them.
+#define SHIM_LAYERS 8
+static Layer *s_layers[SHIM_LAYERS];
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = calloc(1, sizeof(Layer));
+  layer->bounds = frame;
+  for (int i = 0; i < SHIM_LAYERS; i++) {
+    if (!s_layers[i]) {
+      s_layers[i] = layer;
+      break;
+    }
+  }
+  return layer;
+}
+
+void layer_destroy(Layer *layer) {
+  for (int i = 0; i < SHIM_LAYERS; i++) {
+    if (s_layers[i] == layer) {
+      s_layers[i] = NULL;
+    }
+  }
+  free(layer);
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+  return GRect(0, 0, layer->bounds.size.w, layer->bounds.size.h);
+}
+
+void layer_mark_dirty(Layer *layer) {
+  layer->dirty = true;
+}
+
+Window *window_create(void) {
+  Window *window = calloc(1, sizeof(Window));
+  window->root.bounds = SHIM_SCREEN;
+  return window;
+}
+
+void window_destroy(Window *window) {
+  free(window);
+}
+
+Layer *window_get_root_layer(const Window *window) {
+  return (Layer *)&window->root;
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider) {
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+}
+
+void window_stack_push(Window *window, bool animated) {
+  window_stack_remove(window, false);
+  s_stack[s_stack_count++] = window;
+  if (!window->loaded && window->handlers.load) {
+    window->loaded = true;
+    window->handlers.load(window);
+  }
+  window->loaded = true;
+}
+
+bool window_stack_remove(Window *window, bool animated) {
+  for (int i = 0; i < s_stack_count; i++) {
+    if (s_stack[i] == window) {
+      memmove(&s_stack[i], &s_stack[i + 1], (s_stack_count - i - 1) * sizeof(s_stack[0]));
+      s_stack_count--;
+      window->loaded = false;
+      // May destroy the window.
+      if (window->handlers.unload) {
+        window->handlers.unload(window);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void window_stack_pop_all(const bool animated) {
+  while (s_stack_count > 0) {
+    window_stack_remove(s_stack[s_stack_count - 1], animated);
+  }
+}
+
+bool window_stack_contains_window(Window *window) {
+  for (int i = 0; i < s_stack_count; i++) {
+    if (s_stack[i] == window) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Window *shim_window_top(void) {
+  return s_stack_count > 0 ? s_stack[s_stack_count - 1] : NULL;
+}
+
+int shim_window_count(void) {
+  return s_stack_count;
+}
+
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = calloc(1, sizeof(TextLayer));
+  text_layer->layer.bounds = frame;
+  return text_layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer) {
+  free(text_layer);
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  text_layer->text = text;
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment) {
+}
+
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode) {
+}
+
+ScrollLayer *scroll_layer_create(GRect frame) {
+  ScrollLayer *scroll_layer = calloc(1, sizeof(ScrollLayer));
+  scroll_layer->layer.bounds = frame;
+  return scroll_layer;
+}
+
+void scroll_layer_destroy(ScrollLayer *scroll_layer) {
+  free(scroll_layer);
+}
+
+Layer *scroll_layer_get_layer(const ScrollLayer *scroll_layer) {
+  return (Layer *)&scroll_layer->layer;
+}
+
+void scroll_layer_add_child(ScrollLayer *scroll_layer, Layer *child) {
+}
+
+void scroll_layer_set_callbacks(ScrollLayer *scroll_layer, ScrollLayerCallbacks callbacks) {
+}
+
+void scroll_layer_set_click_config_onto_window(ScrollLayer *scroll_layer, Window *window) {
+}
+
+void scroll_layer_set_content_size(ScrollLayer *scroll_layer, GSize size) {
+}
+
+// --- Menu layer ---
+struct MenuLayer {
+  Layer layer;
+  MenuLayerCallbacks callbacks;
+  void *context;
+  MenuIndex selected;
+};
+
+#define SHIM_MENU_LAYERS 8
+static MenuLayer *s_menu_layers[SHIM_MENU_LAYERS];
+
+MenuLayer *menu_layer_create(GRect frame) {
+  MenuLayer *menu_layer = calloc(1, sizeof(MenuLayer));
+  menu_layer->layer.bounds = frame;
+  menu_layer->layer.dirty = true;
+  for (int i = 0; i < SHIM_MENU_LAYERS; i++) {
+    if (!s_menu_layers[i]) {
+      s_menu_layers[i] = menu_layer;
+      break;
+    }
+  }
+  return menu_layer;
+}
+
+void menu_layer_destroy(MenuLayer *menu_layer) {
+  for (int i = 0; i < SHIM_MENU_LAYERS; i++) {
+    if (s_menu_layers[i] == menu_layer) {
+      s_menu_layers[i] = NULL;
+    }
+  }
+  free(menu_layer);
+}
+
+MenuLayer *shim_menu_layer(int index) {
+  return index >= 0 && index < SHIM_MENU_LAYERS ? s_menu_layers[index] : NULL;
+}
+
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer) {
+  return (Layer *)&menu_layer->layer;
+}
+
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks) {
+  menu_layer->callbacks = callbacks;
+  menu_layer->context = callback_context;
+}
+
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, Window *window) {
+}
+
+void menu_layer_reload_data(MenuLayer *menu_layer) {
+  menu_layer->layer.dirty = true;
+}
+
+MenuIndex menu_layer_get_selected_index(const MenuLayer *menu_layer) {
+  return menu_layer->selected;
+}
+
+void menu_layer_set_selected_index(MenuLayer *menu_layer, MenuIndex index, MenuRowAlign scroll_align, bool animated) {
+  menu_layer->selected = index;
+  menu_layer->layer.dirty = true;
+}
+
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title, const char *subtitle,
+                          GBitmap *icon) {
+}
+
+void menu_cell_basic_header_draw(GContext *ctx, const Layer *cell_layer, const char *title) {
+}
+
+bool menu_cell_layer_is_highlighted(const Layer *cell_layer) {
+  return cell_layer->highlighted;
+}
+
+void shim_menu_select(MenuLayer *menu_layer, MenuIndex index) {
+  MenuIndex old = menu_layer->selected;
+  menu_layer->selected = index;
+  menu_layer->layer.dirty = true;
+  if (menu_layer->callbacks.selection_changed) {
+    menu_layer->callbacks.selection_changed(menu_layer, index, old, menu_layer->context);
+  }
+}
+
+void shim_menu_click(MenuLayer *menu_layer) {
+  MenuIndex index = menu_layer->selected;
+  if (menu_layer->callbacks.select_click) {
+    menu_layer->callbacks.select_click(menu_layer, &index, menu_layer->context);
+  }
+}
+
+// Draws the rows from the selected one down until the layer is full.
+static void shim_draw_menu(MenuLayer *menu_layer) {
+  const MenuLayerCallbacks *cb = &menu_layer->callbacks;
+  GContext ctx = { GColorBlack };
+  int16_t y = 0;
+  uint16_t sections = cb->get_num_sections ? cb->get_num_sections(menu_layer, menu_layer->context) : 1;
+  for (uint16_t section = menu_layer->selected.section; section < sections; section++) {
+    uint16_t rows = cb->get_num_rows(menu_layer, section, menu_layer->context);
+    int16_t header = cb->get_header_height ? cb->get_header_height(menu_layer, section, menu_layer->context) : 0;
+    if (header > 0 && cb->draw_header) {
+      Layer cell = { GRect(0, y, menu_layer->layer.bounds.size.w, header), false, false, NULL };
+      cb->draw_header(&ctx, &cell, section, menu_layer->context);
+    }
+    y += header;
+    uint16_t first = section == menu_layer->selected.section ? menu_layer->selected.row : 0;
+    for (uint16_t row = first; row < rows && y < menu_layer->layer.bounds.size.h; row++) {
+      MenuIndex index = MenuIndex(section, row);
+      int16_t height = cb->get_cell_height ? cb->get_cell_height(menu_layer, &index, menu_layer->context) : 44;
+      bool highlighted = section == menu_layer->selected.section && row == menu_layer->selected.row;
+      Layer cell = { GRect(0, y, menu_layer->layer.bounds.size.w, height), false, highlighted, NULL };
+      cb->draw_row(&ctx, &cell, &index, menu_layer->context);
+      shim_rows_drawn++;
+      y += height;
+    }
+  }
+}
+
+void shim_render(void) {
+  bool drawn = false;
+  for (int i = 0; i < SHIM_MENU_LAYERS; i++) {
+    MenuLayer *menu_layer = s_menu_layers[i];
+    if (menu_layer && menu_layer->layer.dirty) {
+      menu_layer->layer.dirty = false;
+      shim_draw_menu(menu_layer);
+      drawn = true;
+    }
+  }
+  GContext ctx = { GColorBlack };
+  for (int i = 0; i < SHIM_LAYERS; i++) {
+    Layer *layer = s_layers[i];
+    if (layer && layer->update_proc && (drawn || layer->dirty)) {
+      layer->dirty = false;
+      layer->update_proc(layer, &ctx);
+    }
+  }
+}
+
+// --- Dictionaries ---
+#define TUPLE_HEADER_SIZE 7
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  size_t offset = 1;
+  while (offset + TUPLE_HEADER_SIZE <= iter->used) {
+    Tuple *tuple = (Tuple *)(iter->buffer + offset);
+    if (tuple->key == key) {
+      return tuple;
+    }
+    offset += TUPLE_HEADER_SIZE + tuple->length;
+  }
+  return NULL;
+}
+
+static DictionaryResult dict_write_tuple(DictionaryIterator *iter, uint32_t key, TupleType type,
+                                         const void *data, uint16_t length) {
+  if (iter->used + TUPLE_HEADER_SIZE + length > iter->size) {
+    return DICT_NOT_ENOUGH_STORAGE;
+  }
+  Tuple *tuple = (Tuple *)(iter->buffer + iter->used);
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = length;
+  memcpy(tuple->value->data, data, length);
+  iter->used += TUPLE_HEADER_SIZE + length;
+  iter->buffer[0]++;
+  return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *data, const uint16_t size) {
+  return dict_write_tuple(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char *cstring) {
+  return dict_write_tuple(iter, key, TUPLE_CSTRING, cstring, strlen(cstring) + 1);
+}
+
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer,
+                                const uint8_t width_bytes, const bool is_signed) {
+  if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4) {
+    return DICT_INVALID_ARGS;
+  }
+  return dict_write_tuple(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+  return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value) {
+  return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value) {
+  return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value) {
+  return dict_write_int(iter, key, &value, sizeof(value), true);
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+  return iter->used;
+}
+
+void shim_dict_begin(DictionaryIterator *iter, uint8_t *buffer, size_t size) {
+  *iter = (DictionaryIterator){ buffer, size, 1 };
+  buffer[0] = 0;
+}
+
+// --- AppMessage ---
+static AppMessageInboxReceived s_inbox_received;
+static AppMessageInboxDropped s_inbox_dropped;
+static AppMessageOutboxSent s_outbox_sent;
+static AppMessageOutboxFailed s_outbox_failed;
+static bool s_outbox_begun = false;
+static bool s_outbox_in_flight = false;
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  shim_outbox_size = size_outbound;
+  return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum(void) {
+  return 8200;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  if (s_outbox_begun || s_outbox_in_flight) {
+    return APP_MSG_BUSY;
+  }
+  ShimMessage *message = &shim_sent[shim_sent_count % SHIM_MAX_SENT];
+  shim_dict_begin(&message->iter, message->buffer, MIN(shim_outbox_size, sizeof(message->buffer)));
+  s_outbox_begun = true;
+  *iterator = &message->iter;
+  return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+  if (!s_outbox_begun) {
+    return APP_MSG_BUSY;
+  }
+  s_outbox_begun = false;
+  s_outbox_in_flight = true;
+  shim_sent_count++;
+  return APP_MSG_OK;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+  s_inbox_received = received_callback;
+  return received_callback;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+  s_inbox_dropped = dropped_callback;
+  return dropped_callback;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+  s_outbox_sent = sent_callback;
+  return sent_callback;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+  s_outbox_failed = failed_callback;
+  return failed_callback;
+}
+
+bool shim_outbox_in_flight(void) {
+  return s_outbox_in_flight;
+}
+
+const DictionaryIterator *shim_last_sent(void) {
+  return shim_sent_count > 0 ? &shim_sent[(shim_sent_count - 1) % SHIM_MAX_SENT].iter : NULL;
+}
+
+void shim_outbox_deliver(bool success) {
+  if (!s_outbox_in_flight) {
+    return;
+  }
+  s_outbox_in_flight = false;
+  DictionaryIterator *iter = &shim_sent[(shim_sent_count - 1) % SHIM_MAX_SENT].iter;
+  if (success && s_outbox_sent) {
+    s_outbox_sent(iter, NULL);
+  } else if (!success && s_outbox_failed) {
+    s_outbox_failed(iter, APP_MSG_SEND_TIMEOUT, NULL);
+  }
+  shim_advance(0);
+}
+
+void shim_outbox_reset(void) {
+  s_outbox_begun = false;
+  s_outbox_in_flight = false;
+  shim_sent_count = 0;
+}
+
+void shim_inbox_deliver(DictionaryIterator *iter) {
+  if (s_inbox_received) {
+    s_inbox_received(iter, NULL);
+  }
+  shim_advance(0);
+}
+
+// --- Timers, time and wakeups ---
+struct AppTimer {
+  uint32_t due;
+  AppTimerCallback callback;
+  void *data;
+};
+
+#define SHIM_TIMERS 32
+static AppTimer *s_timers[SHIM_TIMERS];
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  for (int i = 0; i < SHIM_TIMERS; i++) {
+    if (!s_timers[i]) {
+      s_timers[i] = malloc(sizeof(AppTimer));
+      *s_timers[i] = (AppTimer){ shim_now_ms + timeout_ms, callback, callback_data };
+      return s_timers[i];
+    }
+  }
+  return NULL;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+  for (int i = 0; i < SHIM_TIMERS; i++) {
+    if (s_timers[i] && s_timers[i] == timer_handle) {
+      free(s_timers[i]);
+      s_timers[i] = NULL;
+    }
+  }
+}
+
+// Runs the timers due within ms, earliest first, and moves the clock forward.
+void shim_advance(uint32_t ms) {
+  uint32_t until = shim_now_ms + ms;
+  for (;;) {
+    int next = -1;
+    for (int i = 0; i < SHIM_TIMERS; i++) {
+      if (s_timers[i] && s_timers[i]->due <= until && (next < 0 || s_timers[i]->due < s_timers[next]->due)) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      break;
+    }
+    AppTimer timer = *s_timers[next];
+    free(s_timers[next]);
+    s_timers[next] = NULL;
+    shim_now_ms = MAX(shim_now_ms, timer.due);
+    timer.callback(timer.data);
+  }
+  shim_now_ms = until;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+  if (tloc) {
+    *tloc = shim_now_ms / 1000;
+  }
+  if (out_ms) {
+    *out_ms = shim_now_ms % 1000;
+  }
+  return shim_now_ms % 1000;
+}
+
+time_t clock_to_timestamp(WeekDay day, int hour, int minute) {
+  return time(NULL) + SECONDS_PER_DAY + hour * 3600 + minute * 60;
+}
+
+WakeupId wakeup_schedule(time_t timestamp, int32_t cookie, bool notify_if_missed) {
+  return 1;
+}
+
+void wakeup_cancel_all(void) {
+}
+
+void wakeup_service_subscribe(WakeupHandler handler) {
+}
+
+AppLaunchReason launch_reason(void) {
+  return shim_launch_reason;
+}
+
+void app_event_loop(void) {
+}
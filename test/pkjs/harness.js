@@ -0,0 +1,394 @@
+// Runs the real src/pkjs/index.js in Node against the fixture server (server.js) and a
+// simulated watch, and reports per user flow the wall time, the XHRs it made and the
+// AppMessages and bytes that went over the air in either direction.
+//
+//   node harness.js [--canteens 1,2] [--latency 150] [--jitter 50] [--error-rate 0]
+//                   [--radio-latency 30] [--drop-rate 0] [--chunk-size 4000] [--seed 1]
+//                   [--fail REGEX] [--timeout 10000] [--json] [--verbose]
+//
+// Exits with 1 when a flow goes unanswered within --timeout; an error, "empty" or "failed"
+// answer counts as an answer, e.g. for --fail meals.
+//
+// Pebble, localStorage, XMLHttpRequest, pebble-clay and message_keys are stubbed. The watch
+// answers like OpenMensa.c: it acknowledges chunks, reassembles transfers and keeps the day
+// list, dictionary and meal ids it was sent, which the next flow uses.
+var http = require("http");
+var Module = require("module");
+var path = require("path");
+var replay = require("./server");
+
+var ROOT = path.join(__dirname, "..", "..");
+var options = replay.parseArgs(process.argv.slice(2), {
+  canteens: "1",
+  latency: 150,
+  jitter: 50,
+  errorRate: 0,
+  radioLatency: 30,   // ms for an AppMessage to be delivered and acknowledged.
+  dropRate: 0,        // Share of AppMessages that fail, to exercise the retries.
+  chunkSize: 4000,    // XFER_CHUNK_SIZE of a 64 KB platform; aplite asks for 928.
+  dictCapacity: 768,  // DICT_BYTES of the platform.
+  seed: 1,
+  timeout: 10000      // ms a flow may take before it counts as unanswered.
+});
+var log = console.log;
+if (!options.verbose) {
+  console.log = function() {};
+}
+
+var next = replay.random(options.seed + 1);
+
+var counters = { xhrs: 0, toWatch: 0, toWatchBytes: 0, fromWatch: 0, fromWatchBytes: 0 };
+var busy = 0;  // XHRs and AppMessages in flight.
+var lastActivity = Date.now();
+
+function activity(delta) {
+  busy += delta;
+  lastActivity = Date.now();
+}
+
+// Size of payload as an AppMessage dictionary: a 1 byte header, then per tuple a 7 byte header
+// and the value: 4 bytes for numbers, byte arrays as they are and strings with a terminator.
+function messageBytes(payload) {
+  var bytes = 1;
+  Object.keys(payload).forEach(function(key) {
+    var value = payload[key];
+    bytes += 7;
+    if (Array.isArray(value)) {
+      bytes += value.length;
+    } else if (typeof value === "string") {
+      bytes += Buffer.byteLength(value) + 1;
+    } else {
+      bytes += 4;
+    }
+  });
+  return bytes;
+}
+
+// --- Stubs ---
+var storage = {};
+global.localStorage = {
+  getItem: function(key) { return key in storage ? storage[key] : null; },
+  setItem: function(key, value) { storage[key] = String(value); },
+  removeItem: function(key) { delete storage[key]; },
+  clear: function() { storage = {}; }
+};
+
+function FakeXMLHttpRequest() {
+  this.readyState = 0;
+  this.status = 0;
+  this.statusText = "";
+  this.responseText = "";
+  this.timeout = 0;
+}
+
+FakeXMLHttpRequest.prototype.open = function(method, url) {
+  this.method = method;
+  this.url = url;
+  this.readyState = 1;
+};
+
+FakeXMLHttpRequest.prototype.send = function() {
+  var xhr = this;
+  counters.xhrs++;
+  activity(1);
+  var finished = false;
+  function finish(handler) {
+    if (finished) { return; }
+    finished = true;
+    xhr.readyState = 4;
+    activity(-1);
+    if (handler) { handler.call(xhr); }
+  }
+  xhr.request = http.request(xhr.url, { method: xhr.method }, function(res) {
+    var body = [];
+    res.on("data", function(data) { body.push(data); });
+    res.on("end", function() {
+      xhr.status = res.statusCode;
+      xhr.statusText = res.statusMessage;
+      xhr.responseText = Buffer.concat(body).toString("utf8");
+      finish(xhr.onload);
+    });
+  });
+  xhr.request.on("error", function() {
+    finish(xhr.aborted ? null : xhr.timedOut ? xhr.ontimeout : xhr.onerror);
+  });
+  if (xhr.timeout) {
+    xhr.request.setTimeout(xhr.timeout, function() {
+      xhr.timedOut = true;
+      xhr.request.destroy();
+    });
+  }
+  xhr.request.end();
+};
+
+FakeXMLHttpRequest.prototype.abort = function() {
+  if (!this.request) { return; }
+  this.aborted = true;
+  this.request.destroy();
+};
+
+global.XMLHttpRequest = FakeXMLHttpRequest;
+
+var handlers = {};
+global.Pebble = {
+  addEventListener: function(type, handler) {
+    (handlers[type] = handlers[type] || []).push(handler);
+  },
+  sendAppMessage: function(payload, onSuccess, onFailure) {
+    counters.toWatch++;
+    counters.toWatchBytes += messageBytes(payload);
+    activity(1);
+    setTimeout(function() {
+      activity(-1);
+      if (next() < options.dropRate) {
+        if (onFailure) { onFailure({ data: { error: { message: "Timeout" } } }); }
+        return;
+      }
+      if (onSuccess) { onSuccess({}); }
+      watch.receive(payload);
+    }, options.radioLatency);
+  },
+  openURL: function() {},
+  getActiveWatchInfo: function() { return { platform: "basalt" }; }
+};
+
+function emit(type, e) {
+  (handlers[type] || []).forEach(function(handler) { handler(e); });
+}
+
+function Clay() {}
+Clay.prototype.generateUrl = function() { return "about:blank"; };
+Clay.prototype.getSettings = function() { return {}; };
+
+// message_keys as the SDK generates it from package.json.
+var messageKeys = {};
+require(path.join(ROOT, "package.json")).pebble.messageKeys.forEach(function(key) {
+  var name = key.split("[")[0];
+  if (!(name in messageKeys)) { messageKeys[name] = 10000 + Object.keys(messageKeys).length; }
+});
+
+var stubs = { "pebble-clay": Clay, "message_keys": messageKeys };
+var load = Module._load;
+Module._load = function(request) {
+  return stubs.hasOwnProperty(request) ? stubs[request] : load.apply(this, arguments);
+};
+
+// --- Simulated watch ---
+var XFER_KIND_MEALS = 1;
+var XFER_KIND_DETAILS = 2;
+var XFER_KIND_MEALS_DELTA = 3;
+var XFER_KIND_DICT = 5;
+
+var watch = {
+  days: [],
+  dict: { id: 0, count: 0 },
+  mealIds: [],
+  transfer: null,
+  waiting: null,
+
+  send: function(payload) {
+    counters.fromWatch++;
+    counters.fromWatchBytes += messageBytes(payload);
+    activity(1);
+    setTimeout(function() {
+      activity(-1);
+      emit("appmessage", { payload: payload });
+    }, options.radioLatency);
+  },
+
+  event: function(name) {
+    if (this.waiting && this.waiting.events.indexOf(name) !== -1) {
+      var waiting = this.waiting;
+      this.waiting = null;
+      waiting.resolve(name);
+    }
+  },
+
+  receive: function(payload) {
+    if (payload.ERROR_MSG !== undefined) {
+      this.event("error");
+    } else if (payload.DAY_DATA !== undefined) {
+      var data = payload.DAY_DATA;
+      this.days = [];
+      for (var i = 0; i < data[1]; i++) {
+        this.days.push(data[2 + 2 * i] | (data[3 + 2 * i] << 8));
+      }
+      this.event("days");
+    } else if (payload.DAYS_NOT_MODIFIED !== undefined) {
+      this.event("days");
+    } else if (payload.MEALS_NOT_MODIFIED !== undefined) {
+      this.event("meals");
+    } else if (payload.MEALS_UNAVAILABLE !== undefined) {
+      this.event(payload.MEALS_UNAVAILABLE === 1 ? "empty" : "failed");
+    } else if (payload.MEAL_NAME !== undefined) {
+      this.event("detail");
+    } else if (payload.XFER_ID !== undefined) {
+      this.receiveChunk(payload);
+    }
+  },
+
+  // Reassembles transfers like xfer_receive_chunk() in OpenMensa.c.
+  receiveChunk: function(payload) {
+    var transfer = this.transfer;
+    if (payload.XFER_SEQ === 0 && (!transfer || transfer.id !== payload.XFER_ID)) {
+      transfer = this.transfer = { id: payload.XFER_ID, kind: payload.XFER_KIND, total: payload.XFER_TOTAL,
+                                   bytes: [], nextSeq: 0, first: payload };
+    } else if (!transfer || transfer.id !== payload.XFER_ID) {
+      return;
+    }
+    var reply = { XFER_ID: transfer.id };
+    if (payload.XFER_SEQ === transfer.nextSeq && payload.XFER_OFFSET === transfer.bytes.length &&
+        transfer.bytes.length + payload.XFER_DATA.length <= transfer.total) {
+      Array.prototype.push.apply(transfer.bytes, payload.XFER_DATA);
+      transfer.nextSeq++;
+      reply.XFER_ACK = transfer.nextSeq;
+    } else if (payload.XFER_SEQ < transfer.nextSeq) {
+      reply.XFER_ACK = transfer.nextSeq;
+    } else {
+      reply.XFER_NACK = transfer.nextSeq;
+    }
+    this.send(reply);
+    if (transfer.bytes.length === transfer.total && !transfer.complete) {
+      transfer.complete = true;
+      this.transferComplete(transfer);
+    }
+  },
+
+  transferComplete: function(transfer) {
+    var bytes = transfer.bytes;
+    if (transfer.kind === XFER_KIND_DICT) {
+      this.dict = { id: bytes[1] | (bytes[2] << 8), count: bytes[3] + bytes[4] };
+    } else if (transfer.kind === XFER_KIND_MEALS) {
+      this.mealIds = mealIds(bytes);
+      this.event("meals");
+    } else if (transfer.kind === XFER_KIND_MEALS_DELTA) {
+      this.event("meals");
+    } else if (transfer.kind === XFER_KIND_DETAILS) {
+      this.event("details");
+    }
+  }
+};
+
+// Meal ids of a MEALS_DATA v3 payload: [version][total][sections] then per section
+// [meals][name length][name], then per meal [id:4][cents:2][flags][name length][name].
+function mealIds(bytes) {
+  var ids = [];
+  var offset = 3;
+  for (var section = 0; section < bytes[2]; section++) {
+    offset += 2 + bytes[offset + 1];
+  }
+  while (offset + 8 <= bytes.length) {
+    ids.push(bytes[offset] | (bytes[offset + 1] << 8) | (bytes[offset + 2] << 16) | (bytes[offset + 3] << 24));
+    offset += 8 + bytes[offset + 7];
+  }
+  return ids;
+}
+
+// --- Flows ---
+function waitFor(events) {
+  return new Promise(function(resolve) {
+    var timer = setTimeout(function() {
+      watch.waiting = null;
+      resolve("timeout");
+    }, options.timeout);
+    watch.waiting = { events: events, resolve: function(name) {
+      clearTimeout(timer);
+      resolve(name);
+    } };
+  });
+}
+
+// Resolves once nothing was in flight for a while, so background work counts to the flow.
+function idle() {
+  return new Promise(function(resolve) {
+    var poll = setInterval(function() {
+      if (busy === 0 && Date.now() - lastActivity >= 250) {
+        clearInterval(poll);
+        resolve();
+      }
+    }, 10);
+  });
+}
+
+function elapsedMs(start) {
+  var diff = process.hrtime(start);
+  return diff[0] * 1000 + diff[1] / 1e6;
+}
+
+// Runs trigger and measures until the watch saw one of events (answer) and until the phone
+// went quiet (settled), with the counters over the whole span.
+function flow(name, events, trigger) {
+  var before = Object.assign({}, counters);
+  var start = process.hrtime();
+  var answered = waitFor(events);
+  trigger();
+  return answered.then(function(outcome) {
+    var answerMs = elapsedMs(start);
+    return idle().then(function() {
+      var result = { flow: name, outcome: outcome, answerMs: Math.round(answerMs), settledMs: Math.round(Math.max(answerMs, elapsedMs(start) - 250)) };
+      Object.keys(counters).forEach(function(key) { result[key] = counters[key] - before[key]; });
+      return result;
+    });
+  });
+}
+
+function report(results) {
+  if (options.json) {
+    log(JSON.stringify(results, null, 2));
+    return;
+  }
+  log("flow          outcome   answer ms  settled ms  XHRs  to watch (msgs/bytes)  from watch (msgs/bytes)");
+  results.forEach(function(r) {
+    log(pad(r.flow, 13) + " " + pad(r.outcome, 9) + " " + lpad(r.answerMs, 9) + " " + lpad(r.settledMs, 11) + " " +
+        lpad(r.xhrs, 5) + " " + lpad(r.toWatch + " / " + r.toWatchBytes, 22) + " " +
+        lpad(r.fromWatch + " / " + r.fromWatchBytes, 24));
+  });
+}
+
+function pad(value, width) {
+  return (String(value) + new Array(width + 1).join(" ")).slice(0, width);
+}
+
+function lpad(value, width) {
+  return (new Array(width + 1).join(" ") + value).slice(-width);
+}
+
+// Each flow starts from what the previous one left on the watch; once one gets no answer the
+// rest are not run.
+var FLOWS = [
+  { name: "startup", events: ["days", "error"], trigger: function() {
+    require(path.join(ROOT, "src", "pkjs", "index.js"));
+    emit("ready", {});
+    watch.send({ DAYS_HASH: 0, XFER_CHUNK_SIZE: options.chunkSize });
+  } },
+  { name: "select day", events: ["meals", "empty", "failed", "error"], trigger: function() {
+    watch.send({ SELECTED_DAY: watch.days[0], XFER_CHUNK_SIZE: options.chunkSize, DICT_ID: watch.dict.id,
+                 DICT_COUNT: watch.dict.count, DICT_CAPACITY: options.dictCapacity });
+  } },
+  { name: "select meal", events: ["detail", "error"], trigger: function() {
+    watch.send({ MEAL_ID: watch.mealIds[0] });
+  } }
+];
+
+var server = replay.createServer(options);
+server.listen(0, "127.0.0.1", function() {
+  localStorage.setItem("openmensaID", String(options.canteens));
+  localStorage.setItem("API_BASE_URL", "http://127.0.0.1:" + server.address().port);
+  var results = [];
+  // Each flow needs the one before to succeed; an error answer ends the run without failing it.
+  FLOWS.reduce(function(previous, step) {
+    return previous.then(function(ok) {
+      if (!ok) { return false; }
+      return flow(step.name, step.events, step.trigger).then(function(result) {
+        results.push(result);
+        return result.outcome === step.events[0];
+      });
+    });
+  }, Promise.resolve(true)).then(function() {
+    var ok = results.every(function(result) { return result.outcome !== "timeout"; });
+    report(results);
+    server.close();
+    // index.js may still hold timers, e.g. the debounced store save.
+    process.exit(ok ? 0 : 1);
+  });
+});
@@ -0,0 +1,95 @@
+// Replays recorded OpenMensa API responses from fixtures/ with configurable latency and errors,
+// so the phone side can be run and measured without the live service. Point the API URL in
+// the app's settings (or harness.js) at it:
+//
+//   node server.js [--port 8080] [--latency 150] [--jitter 50] [--error-rate 0.1]
+//                  [--error-status 503] [--fail REGEX] [--seed 1]
+//
+// GET /canteens/1/days/2026-10-19/meals answers fixtures/canteens/1/days/2026-10-19/meals.json.
+// Dates are shifted by the days between fixtures/recorded.json and today, in request paths and
+// in responses, so the recorded week always lies ahead.
+var fs = require("fs");
+var http = require("http");
+var path = require("path");
+
+var FIXTURES = path.join(__dirname, "fixtures");
+var MS_PER_DAY = 86400000;
+var DATE = /\d{4}-\d{2}-\d{2}/g;
+
+function todayUtc() {
+  var now = new Date();
+  return Date.UTC(now.getFullYear(), now.getMonth(), now.getDate());
+}
+
+function shiftDate(date, days) {
+  return new Date(Date.parse(date) + days * MS_PER_DAY).toISOString().slice(0, 10);
+}
+
+// Small deterministic generator (mulberry32), so a run with the same seed fails the same requests.
+function random(seed) {
+  var state = seed >>> 0;
+  return function() {
+    state = (state + 0x6D2B79F5) >>> 0;
+    var t = Math.imul(state ^ (state >>> 15), state | 1);
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+    return ((t ^ (t >>> 14)) >>> 0) / 0x100000000;
+  };
+}
+
+// options: { fixtures, latency, jitter, errorRate, errorStatus, fail (RegExp), seed, shift }
+function createServer(options) {
+  options = options || {};
+  var fixtures = options.fixtures || FIXTURES;
+  var recorded = JSON.parse(fs.readFileSync(path.join(fixtures, "recorded.json"), "utf8")).date;
+  var shift = options.shift === false ? 0 : Math.round((todayUtc() - Date.parse(recorded)) / MS_PER_DAY);
+  var next = random(options.seed || 1);
+  var stats = { requests: 0, errors: 0 };
+
+  var server = http.createServer(function(req, res) {
+    stats.requests++;
+    var urlPath = req.url.split("?")[0].replace(/\/+$/, "");
+    var delay = (options.latency || 0) + Math.floor(next() * (options.jitter || 0));
+    setTimeout(function() {
+      if ((options.fail && options.fail.test(urlPath)) || next() < (options.errorRate || 0)) {
+        stats.errors++;
+        res.writeHead(options.errorStatus || 503, { "Content-Type": "text/plain" });
+        res.end("Injected error\n");
+        return;
+      }
+      var recordedPath = urlPath.replace(DATE, function(date) { return shiftDate(date, -shift); });
+      var file = path.join(fixtures, path.normalize(recordedPath) + ".json");
+      if (req.method !== "GET" || file.indexOf(fixtures) !== 0 || !fs.existsSync(file)) {
+        res.writeHead(404, { "Content-Type": "application/json" });
+        res.end("{\"error\":\"not found\"}");
+        return;
+      }
+      var body = fs.readFileSync(file, "utf8").replace(DATE, function(date) { return shiftDate(date, shift); });
+      res.writeHead(200, { "Content-Type": "application/json; charset=utf-8" });
+      res.end(body);
+    }, delay);
+  });
+  server.stats = stats;
+  return server;
+}
+
+// Parses --name value pairs into options for createServer and the harness.
+function parseArgs(argv, defaults) {
+  var options = Object.assign({}, defaults);
+  for (var i = 0; i < argv.length; i++) {
+    var match = /^--([a-z-]+)$/.exec(argv[i]);
+    if (!match) { continue; }
+    var name = match[1].replace(/-([a-z])/g, function(all, letter) { return letter.toUpperCase(); });
+    var value = argv[i + 1] !== undefined && argv[i + 1].indexOf("--") !== 0 ? argv[++i] : "true";
+    options[name] = name === "fail" ? new RegExp(value) : isNaN(Number(value)) ? value : Number(value);
+  }
+  return options;
+}
+
+module.exports = { createServer: createServer, parseArgs: parseArgs, random: random };
+
+if (require.main === module) {
+  var options = parseArgs(process.argv.slice(2), { port: 8080 });
+  createServer(options).listen(options.port, function() {
+    console.log("Replaying " + FIXTURES + " on http://localhost:" + options.port);
+  });
+}
@@ -0,0 +1,1089 @@
+// Host tests, fuzzing and benchmarks for the data paths of src/c/OpenMensa.c (see Makefile).
+// The app is compiled into this file so the tests can reach its static functions and state.
+// Every test runs in a child process that starts from the app's initial state.
+#include <pebble.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"  // The app's main() relies on the implicit return.
+#define main openmensa_main
+#include "../src/c/OpenMensa.c"
+#undef main
+#pragma GCC diagnostic pop
+
+const char *__asan_default_options(void) {
+  return "detect_leaks=0";  // The app leaves its windows to the system at exit.
+}
+
+static int s_checks = 0;
+static int s_failures = 0;
+
+#define CHECK(cond) do { \
+    s_checks++; \
+    if (!(cond)) { \
+      s_failures++; \
+      fprintf(stderr, "  %s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+    } \
+  } while (0)
+
+// --- Payloads ---
+typedef struct {
+  uint8_t data[8192];
+  uint16_t length;
+} Payload;
+
+static void put8(Payload *p, uint8_t value) {
+  p->data[p->length++] = value;
+}
+
+static void put16(Payload *p, uint16_t value) {
+  put8(p, value & 0xFF);
+  put8(p, value >> 8);
+}
+
+static void put32(Payload *p, uint32_t value) {
+  put16(p, value & 0xFFFF);
+  put16(p, value >> 16);
+}
+
+static void put_bytes(Payload *p, const void *bytes, size_t length) {
+  memcpy(p->data + p->length, bytes, length);
+  p->length += length;
+}
+
+// [length:1][bytes]
+static void put_string(Payload *p, const char *str) {
+  put8(p, strlen(str));
+  put_bytes(p, str, strlen(str));
+}
+
+typedef struct {
+  int32_t id;
+  uint16_t cents;
+  uint8_t flags;
+  const char *name;
+} TestMeal;
+
+static const TestMeal s_golden_meals[] = {
+  { 101, 250, MEAL_FLAG_VEGAN, "Linsencurry mit Reis" },
+  { 102, 320, 0, "Schnitzel mit Pommes frites und Salat" },
+  { 103, MEALS_DATA_NO_PRICE, MEAL_FLAG_VEGETARIAN, "Käsespätzle" },
+  { 201, 180, MEAL_FLAG_FISH, "Fischstäbchen" },
+  { 202, 95, 0, "Suppe" },
+};
+#define GOLDEN_MEALS 5
+#define TEST_DAY 20000
+#define TEST_REV 0x1234567
+
+static void put_meal(Payload *p, const TestMeal *meal) {
+  put32(p, meal->id);
+  put16(p, meal->cents);
+  put8(p, meal->flags);
+  put_string(p, meal->name);
+}
+
+// MEALS_DATA v3 with the golden meals in two canteen sections.
+static void golden_meals(Payload *p) {
+  p->length = 0;
+  put8(p, MEALS_DATA_VERSION);
+  put8(p, GOLDEN_MEALS);
+  put8(p, 2);
+  put8(p, 3);
+  put_string(p, "Mensa Nord");
+  put8(p, 2);
+  put_string(p, "Cafeteria");
+  for (int i = 0; i < GOLDEN_MEALS; i++) {
+    put_meal(p, &s_golden_meals[i]);
+  }
+}
+
+// Meal i of a long generated list, all in one unnamed section.
+static TestMeal long_meal(int i) {
+  static char names[256][48];
+  snprintf(names[i], sizeof(names[i]), "Gericht %d mit Beilage nach Wahl", i);
+  return (TestMeal){ 1000 + i, 100 + i, i % 3 == 0 ? MEAL_FLAG_VEGAN : 0, names[i] };
+}
+
+// MEALS_DATA v3 announcing total meals of which the first count are included.
+static void long_meals(Payload *p, int total, int count) {
+  p->length = 0;
+  put8(p, MEALS_DATA_VERSION);
+  put8(p, total);
+  put8(p, 1);
+  put8(p, total);
+  put_string(p, "");
+  for (int i = 0; i < count; i++) {
+    TestMeal meal = long_meal(i);
+    put_meal(p, &meal);
+  }
+}
+
+static void meals_page(Payload *p, uint32_t rev, int first, int count) {
+  p->length = 0;
+  put8(p, MEALS_PAGE_VERSION);
+  put32(p, rev);
+  put8(p, first);
+  put8(p, count);
+  for (int i = first; i < first + count; i++) {
+    TestMeal meal = long_meal(i);
+    put_meal(p, &meal);
+  }
+}
+
+// Against the golden list: removes 102, adds a meal at the top of the second section and
+// changes the price and name of 101.
+static void golden_delta(Payload *p) {
+  static const TestMeal added = { 203, 400, MEAL_FLAG_VEGETARIAN, "Gemüsepfanne" };
+  p->length = 0;
+  put8(p, MEALS_DELTA_VERSION);
+  put32(p, TEST_REV);
+  put8(p, 3);
+  put8(p, DELTA_OP_REMOVE);
+  put32(p, 102);
+  put8(p, DELTA_OP_ADD);
+  put8(p, 1);
+  put8(p, 0);
+  put_meal(p, &added);
+  put8(p, DELTA_OP_CHANGE);
+  put32(p, 101);
+  put8(p, DELTA_FIELD_PRICE | DELTA_FIELD_NAME);
+  put16(p, 275);
+  put_string(p, "Linsencurry");
+}
+
+static void golden_dict(Payload *p) {
+  p->length = 0;
+  put8(p, DICT_DATA_VERSION);
+  put16(p, 0xBEEF);
+  put8(p, 0);
+  put8(p, 2);
+  put_string(p, "Kartoffel");
+  put_string(p, "Schnitzel");
+}
+
+// [count] then "mit Farbstoff" (code 0), the literal "Hallo" and "Weizen" (code 13).
+static void golden_notes(Payload *p) {
+  p->length = 0;
+  put8(p, 3);
+  put8(p, 0);
+  put8(p, NOTE_LITERAL);
+  put_string(p, "Hallo");
+  put8(p, 13);
+}
+
+// Copies length bytes of p into a block of exactly that size, so the sanitizers catch reads
+// past the end of a truncated payload.
+static uint8_t *exact_copy(const Payload *p, uint16_t length) {
+  uint8_t *copy = malloc(length ? length : 1);
+  memcpy(copy, p->data, length);
+  return copy;
+}
+
+// --- Random mutations ---
+static uint32_t s_seed = 1;
+
+static uint32_t next_random(void) {
+  s_seed = s_seed * 1103515245 + 12345;
+  return s_seed >> 8;
+}
+
+// Flips up to four random bytes and sometimes cuts the payload at a random length.
+static uint16_t mutate(Payload *p) {
+  int flips = 1 + next_random() % 4;
+  for (int i = 0; i < flips && p->length > 0; i++) {
+    p->data[next_random() % p->length] = next_random();
+  }
+  return next_random() % 4 == 0 ? next_random() % (p->length + 1) : p->length;
+}
+
+// --- App helpers ---
+static void app_start(void) {
+  prv_init();
+  shim_outbox_deliver(true);  // Hello.
+}
+
+static bool meals_consistent(void) {
+  if (s_meal_count < 0 || s_meal_count > MAX_MEALS || s_meals_first < 0 ||
+      s_meals_first + s_meal_count > MAX(s_meal_total, s_meal_count) ||
+      s_section_count < 0 || s_section_count > MAX_SECTIONS || s_meal_arena.used > s_meal_arena.capacity) {
+    return false;
+  }
+  for (int i = 0; i < s_section_count; i++) {
+    if (s_section_first[i] > s_section_first[i + 1]) {
+      return false;
+    }
+  }
+  for (int i = 0; i < s_meal_count; i++) {
+    if (!s_meal_titles[i] || !s_meal_subtitles[i] ||
+        strlen(s_meal_titles[i]) > 255 || strlen(s_meal_subtitles[i]) >= 12) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void load_golden_meals(void) {
+  Payload p;
+  golden_meals(&p);
+  free_meals();
+  s_meal_count = parse_meals_data(p.data, p.length);
+  s_meals_rev = TEST_REV;
+  classify_meals();
+}
+
+// Builds an XFER chunk as PebbleKit JS sends it (integers as int32) and delivers it.
+static void deliver_chunk(uint8_t id, uint8_t seq, uint32_t offset, const uint8_t *data, uint16_t length,
+                          uint32_t total, uint8_t kind, uint16_t day, uint32_t rev) {
+  static uint8_t buffer[8200];
+  DictionaryIterator iter;
+  shim_dict_begin(&iter, buffer, sizeof(buffer));
+  dict_write_int32(&iter, MESSAGE_KEY_XFER_ID, id);
+  dict_write_int32(&iter, MESSAGE_KEY_XFER_SEQ, seq);
+  dict_write_int32(&iter, MESSAGE_KEY_XFER_OFFSET, offset);
+  dict_write_int32(&iter, MESSAGE_KEY_XFER_TOTAL, total);
+  dict_write_int32(&iter, MESSAGE_KEY_XFER_KIND, kind);
+  dict_write_data(&iter, MESSAGE_KEY_XFER_DATA, data, length);
+  if (seq == 0 && day) {
+    dict_write_int32(&iter, MESSAGE_KEY_SELECTED_DAY, day);
+    dict_write_int32(&iter, MESSAGE_KEY_MEALS_REV, rev);
+  }
+  shim_inbox_deliver(&iter);
+}
+
+// Sends p as transfer id in chunks of the size the watch asks for, delivering every reply.
+static void deliver_transfer(uint8_t id, uint8_t kind, const Payload *p, uint16_t day, uint32_t rev) {
+  uint16_t chunk = s_inbox_size - XFER_OVERHEAD;
+  for (uint16_t offset = 0, seq = 0; offset < p->length; offset += chunk, seq++) {
+    deliver_chunk(id, seq, offset, p->data + offset, MIN(chunk, p->length - offset), p->length, kind, day, rev);
+    shim_outbox_deliver(true);
+  }
+}
+
+static int reply_value(uint32_t key) {
+  const DictionaryIterator *sent = shim_last_sent();
+  Tuple *tuple = sent ? dict_find(sent, key) : NULL;
+  return tuple ? tuple->value->uint8 : -1;
+}
+
+// --- Meals ---
+static void test_parse_meals_golden(void) {
+  Payload p;
+  golden_meals(&p);
+  CHECK(parse_meals_data(p.data, p.length) == GOLDEN_MEALS);
+  s_meal_count = GOLDEN_MEALS;
+  CHECK(s_meal_total == GOLDEN_MEALS);
+  CHECK(s_section_count == 2);
+  CHECK(s_section_first[0] == 0 && s_section_first[1] == 3 && s_section_first[2] == 5);
+  CHECK(strcmp(s_section_names[0], "Mensa Nord") == 0);
+  CHECK(strcmp(s_section_names[1], "Cafeteria") == 0);
+  for (int i = 0; i < GOLDEN_MEALS; i++) {
+    CHECK(s_meal_ids[i] == s_golden_meals[i].id);
+    CHECK(s_meal_flags[i] == s_golden_meals[i].flags);
+    CHECK(strcmp(s_meal_titles[i], s_golden_meals[i].name) == 0);
+  }
+  CHECK(strcmp(s_meal_subtitles[0], "2.50€") == 0);
+  CHECK(strcmp(s_meal_subtitles[2], "N/A") == 0);
+  CHECK(strcmp(s_meal_subtitles[4], "0.95€") == 0);
+  CHECK(meals_consistent());
+}
+
+static void test_parse_meals_paged(void) {
+  Payload p;
+  long_meals(&p, 25, MEALS_PAGE_SIZE);
+  int count = parse_meals_data(p.data, p.length);
+  CHECK(count == MEALS_PAGE_SIZE);
+  s_meal_count = count;
+  CHECK(s_meal_total == 25);
+  CHECK(s_section_count == 1 && s_section_first[1] == 25);
+  CHECK(meals_consistent());
+}
+
+static void test_parse_meals_corrupt(void) {
+  Payload p;
+  golden_meals(&p);
+  p.data[0] = MEALS_DATA_VERSION + 1;
+  CHECK(parse_meals_data(p.data, p.length) == -1);
+  CHECK(parse_meals_data(p.data, 1) == -1);
+
+  golden_meals(&p);
+  for (uint16_t length = 0; length <= p.length; length++) {
+    uint8_t *data = exact_copy(&p, length);
+    free_meals();
+    int count = parse_meals_data(data, length);
+    CHECK(count == (length < MEALS_DATA_HEADER_SIZE ? -1 : count));
+    CHECK(count <= GOLDEN_MEALS);
+    s_meal_count = MAX(count, 0);
+    CHECK(meals_consistent());
+    free(data);
+  }
+  CHECK(s_meal_count == GOLDEN_MEALS);
+
+  // A cut-off section table is rejected rather than leaving sections past the list.
+  free_meals();
+  CHECK(parse_meals_data(p.data, MEALS_DATA_HEADER_SIZE + 4) == -1);
+  CHECK(s_section_count == 0);
+
+  // A name running past the end and more meals announced than sent.
+  golden_meals(&p);
+  p.data[p.length - 6] = 200;
+  free_meals();
+  s_meal_count = parse_meals_data(p.data, p.length);
+  CHECK(s_meal_count == GOLDEN_MEALS - 1);
+  CHECK(meals_consistent());
+}
+
+static void test_meals_data_message(void) {
+  app_start();
+  Payload p;
+  golden_meals(&p);
+  s_selected_day = TEST_DAY;
+  deliver_transfer(1, XFER_KIND_MEALS, &p, TEST_DAY, TEST_REV);
+  CHECK(s_meal_count == GOLDEN_MEALS);
+  CHECK(s_meals_rev == TEST_REV);
+  CHECK(s_meals_menu_layer != NULL);
+  CHECK(window_stack_contains_window(s_meals_window));
+  CHECK(s_meal_bitmaps[0] == s_icon_cache[ICON_VEGAN].bitmap);
+  CHECK(s_meal_bitmaps[1] == s_icon_cache[ICON_POT].bitmap);
+  // Filed in the persistent cache for the next launch.
+  free_meals();
+  CHECK(cache_load_meals(TEST_DAY));
+  CHECK(s_meal_count == GOLDEN_MEALS && s_meals_rev == TEST_REV);
+}
+
+static void test_meal_cache_failures(void) {
+  Payload p;
+  long_meals(&p, 16, 16);
+  CHECK(p.length > 2 * PERSIST_DATA_MAX_LENGTH);
+  // The second chunk does not fit: nothing of the slot is left behind.
+  shim_persist.fail_after = 1;
+  cache_store_meals(TEST_DAY, p.data, p.length, TEST_REV);
+  shim_persist.fail_after = -1;
+  CHECK(!cache_load_meals(TEST_DAY));
+  CHECK(shim_persist_used() == 0);
+  // The header is the last write and fails too.
+  shim_persist.fail_after = (p.length + PERSIST_DATA_MAX_LENGTH - 1) / PERSIST_DATA_MAX_LENGTH;
+  cache_store_meals(TEST_DAY, p.data, p.length, TEST_REV);
+  shim_persist.fail_after = -1;
+  CHECK(!cache_load_meals(TEST_DAY));
+  CHECK(shim_persist_used() == 0);
+  // Out of storage.
+  shim_persist.capacity = p.length / 2;
+  cache_store_meals(TEST_DAY, p.data, p.length, TEST_REV);
+  CHECK(!cache_load_meals(TEST_DAY));
+  shim_persist.capacity = 4096;
+
+  // A slot with a chunk missing is dropped when read.
+  cache_store_meals(TEST_DAY, p.data, p.length, TEST_REV);
+  CHECK(cache_load_meals(TEST_DAY));
+  persist_delete(PERSIST_KEY_MEAL_CHUNK + 1);
+  CHECK(!cache_load_meals(TEST_DAY));
+  CHECK(!persist_exists(PERSIST_KEY_MEAL_SLOT));
+  CHECK(shim_persist_used() == 0);
+}
+
+static void test_storage_budget(void) {
+  // Every persistent value at its largest fits the 4 KB of storage at once.
+  s_menu_item_count = MAX_MENU_ITEMS;
+  cache_store_day_list();
+  static uint8_t data[MEAL_CACHE_MAX_CHUNKS * PERSIST_DATA_MAX_LENGTH];
+  memset(data, 'x', sizeof(data));
+  for (int slot = 0; slot < MEAL_CACHE_SLOTS; slot++) {
+    cache_store_meals(TEST_DAY + slot, data, sizeof(data), TEST_REV);
+    CHECK(persist_exists(PERSIST_KEY_MEAL_SLOT + slot));
+  }
+  Payload p;
+  p.length = 0;
+  put8(&p, DICT_DATA_VERSION);
+  put16(&p, 0xBEEF);
+  put8(&p, 0);
+  put8(&p, DICT_BYTES / 48);
+  for (int i = 0; i < DICT_BYTES / 48; i++) {
+    put_string(&p, "Kartoffelpuffer mit Apfelmus und Preiselbeeren.");
+  }
+  handle_dict_data(p.data, p.length);
+  CHECK(s_dict.used == DICT_BYTES && persist_exists(PERSIST_KEY_DICT));
+  persist_write_int(PERSIST_KEY_PREWARM_TIME, 7 * 60);
+  persist_write_int(PERSIST_KEY_PREWARM_LAST, 1);
+  CHECK(persist_exists(PERSIST_KEY_DAY_LIST) && persist_exists(PERSIST_KEY_PREWARM_LAST));
+  CHECK(shim_persist_used() <= 4096);
+
+  // A dictionary that cannot be stored leaves no header behind.
+  shim_persist.fail_after = 1;
+  dict_store();
+  shim_persist.fail_after = -1;
+  CHECK(!persist_exists(PERSIST_KEY_DICT));
+}
+
+static void deliver_unavailable(uint16_t day, uint8_t reason) {
+  static uint8_t buffer[64];
+  DictionaryIterator iter;
+  shim_dict_begin(&iter, buffer, sizeof(buffer));
+  dict_write_uint8(&iter, MESSAGE_KEY_MEALS_UNAVAILABLE, reason);
+  dict_write_uint16(&iter, MESSAGE_KEY_SELECTED_DAY, day);
+  shim_inbox_deliver(&iter);
+}
+
+static void test_meals_unavailable(void) {
+  app_start();
+  // A failed fetch keeps the list on screen and says it is not current; the app stays open.
+  Payload p;
+  golden_meals(&p);
+  s_selected_day = TEST_DAY;
+  handle_meals_data(p.data, p.length, TEST_DAY, TEST_REV);
+  s_meals_stale = true;
+  int windows = shim_window_count();
+  deliver_unavailable(TEST_DAY, MEALS_UNAVAILABLE_FAILED);
+  shim_advance(0);
+  shim_render();
+  CHECK(s_meal_count == GOLDEN_MEALS && !s_meals_stale && strcmp(meals_status(), "Not updated") == 0);
+  CHECK(shim_window_count() == windows && s_error_window == NULL);
+  // An answer for another day changes nothing.
+  deliver_unavailable(TEST_DAY + 1, MEALS_UNAVAILABLE_NONE);
+  CHECK(s_meal_count == GOLDEN_MEALS);
+  // A day without meals empties the list and says so.
+  deliver_unavailable(TEST_DAY, MEALS_UNAVAILABLE_NONE);
+  shim_advance(0);
+  shim_render();
+  CHECK(s_meal_count == 0 && strcmp(meals_status(), "No meals served") == 0);
+  CHECK(shim_window_count() == windows && s_error_window == NULL);
+  // New meals drop the notice.
+  handle_meals_data(p.data, p.length, TEST_DAY, TEST_REV);
+  CHECK(meals_status() == NULL);
+}
+
+// --- Deltas ---
+static void test_delta_golden(void) {
+  app_start();
+  Payload p;
+  golden_meals(&p);
+  s_selected_day = TEST_DAY;
+  handle_meals_data(p.data, p.length, TEST_DAY, TEST_REV);
+  golden_delta(&p);
+  handle_meals_delta(p.data, p.length, TEST_DAY, TEST_REV + 1);
+  CHECK(s_meals_rev == TEST_REV + 1);
+  CHECK(s_meal_count == GOLDEN_MEALS);
+  CHECK(s_section_first[1] == 2 && s_section_first[2] == 5);
+  CHECK(s_meal_ids[0] == 101 && s_meal_ids[1] == 103 && s_meal_ids[2] == 203 && s_meal_ids[3] == 201);
+  CHECK(strcmp(s_meal_titles[0], "Linsencurry") == 0);
+  CHECK(strcmp(s_meal_subtitles[0], "2.75€") == 0);
+  CHECK(strcmp(s_meal_titles[2], "Gemüsepfanne") == 0);
+  CHECK(meals_consistent());
+
+  // A delta against another revision is not applied.
+  golden_delta(&p);
+  handle_meals_delta(p.data, p.length, TEST_DAY, TEST_REV + 2);
+  CHECK(s_meals_rev == 0);
+  CHECK(s_meal_count == GOLDEN_MEALS);
+  shim_outbox_deliver(true);
+
+  // The full list is requested once the ack of the transfer has left the outbox.
+  s_meals_rev = TEST_REV + 3;
+  deliver_chunk(9, 0, 0, p.data, p.length, p.length, XFER_KIND_MEALS_DELTA, TEST_DAY, TEST_REV + 4);
+  CHECK(reply_value(MESSAGE_KEY_XFER_ACK) == 1 && s_meals_rev == 0);
+  shim_outbox_deliver(true);
+  Tuple *day = dict_find(shim_last_sent(), MESSAGE_KEY_SELECTED_DAY);
+  CHECK(day && day->value->uint16 == TEST_DAY && reply_value(MESSAGE_KEY_XFER_ACK) == -1);
+  CHECK(!s_meals_request_pending);
+}
+
+static void test_delta_short_names(void) {
+  app_start();
+  Payload p;
+  golden_meals(&p);
+  s_selected_day = TEST_DAY;
+  handle_meals_data(p.data, p.length, TEST_DAY, TEST_REV);
+  // The list is loaded again with its long name cut, as under memory pressure.
+  s_mem_level = MEM_LEVEL_SHORT_NAMES;
+  load_golden_meals();
+  CHECK(strlen(s_meal_titles[1]) == MEM_SHORT_NAME_BYTES);
+  golden_delta(&p);
+  handle_meals_delta(p.data, p.length, TEST_DAY, TEST_REV + 1);
+  CHECK(s_meals_rev == TEST_REV + 1);
+  // The cache keeps the full names under the revision they belong to.
+  s_mem_level = MEM_LEVEL_NORMAL;
+  free_meals();
+  CHECK(cache_load_meals(TEST_DAY));
+  CHECK(s_meals_rev == TEST_REV && strcmp(s_meal_titles[1], s_golden_meals[1].name) == 0);
+}
+
+static void test_delta_corrupt(void) {
+  Payload p;
+  golden_delta(&p);
+  meals_layout_rows(144);
+  for (uint16_t length = MEALS_DELTA_HEADER_SIZE; length <= p.length; length++) {
+    uint8_t *data = exact_copy(&p, length);
+    load_golden_meals();
+    bool relayout = false;
+    bool applied = apply_meals_delta(data, length, &relayout);
+    CHECK(applied == (length == p.length) || length < p.length);
+    CHECK(meals_consistent());
+    free(data);
+  }
+  // Unknown op, change of a meal that is not there, add to a missing section.
+  static const uint8_t bad_ops[][12] = {
+    { MEALS_DELTA_VERSION, 0x67, 0x45, 0x23, 0x01, 1, 9, 0, 0, 0, 0, 0 },
+    { MEALS_DELTA_VERSION, 0x67, 0x45, 0x23, 0x01, 1, DELTA_OP_CHANGE, 1, 2, 3, 4, DELTA_FIELD_FLAGS },
+    { MEALS_DELTA_VERSION, 0x67, 0x45, 0x23, 0x01, 1, DELTA_OP_ADD, 7, 0, 0, 0, 0 },
+  };
+  for (size_t i = 0; i < sizeof(bad_ops) / sizeof(bad_ops[0]); i++) {
+    load_golden_meals();
+    bool relayout = false;
+    CHECK(!apply_meals_delta(bad_ops[i], sizeof(bad_ops[i]), &relayout));
+    CHECK(meals_consistent());
+  }
+}
+
+// --- Row layout ---
+static void test_row_layout(void) {
+  app_start();
+  Payload p;
+  golden_meals(&p);
+  s_selected_day = TEST_DAY;
+  handle_meals_data(p.data, p.length, TEST_DAY, TEST_REV);
+  shim_render();
+  // The long name takes two lines beside the icon; every row was measured once, for both columns.
+  CHECK(s_meal_rows[1].title_height[MEAL_COLUMN_BESIDE_ICON] == 2 * s_meal_title_line_height);
+  CHECK(s_meal_rows[1].title_height[MEAL_COLUMN_FULL_WIDTH] <= s_meal_rows[1].title_height[MEAL_COLUMN_BESIDE_ICON]);
+  uint32_t layouts = shim_text_layouts;
+  uint32_t drawn = shim_rows_drawn;
+  layer_mark_dirty(menu_layer_get_layer(s_meals_menu_layer));
+  shim_render();
+  CHECK(shim_rows_drawn > drawn);
+  CHECK(shim_text_layouts == layouts);
+
+  // Dropping the icons switches the rows to the full width column without measuring again.
+  governor_apply(MEM_LEVEL_NO_ICONS);
+  shim_outbox_deliver(true);
+  shim_render();
+  CHECK(s_meal_bitmaps[1] == NULL);
+  CHECK(meals_menu_get_cell_height_callback(s_meals_menu_layer, &MenuIndex(0, 1), NULL) ==
+        2 * MEAL_ROW_PADDING + s_meal_rows[1].title_height[MEAL_COLUMN_FULL_WIDTH] + 2 + s_meal_price_line_height);
+  CHECK(shim_text_layouts == layouts);
+
+  // A new list is measured again.
+  handle_meals_data(p.data, p.length, TEST_DAY, TEST_REV);
+  shim_advance(0);
+  shim_render();
+  CHECK(shim_text_layouts > layouts);
+}
+
+// --- Diagnostics ---
+static void test_diag_report(void) {
+  app_start();
+  Payload p;
+  golden_meals(&p);
+  s_selected_day = TEST_DAY;
+  handle_meals_data(p.data, p.length, TEST_DAY, TEST_REV);
+  shim_render();
+  // A reload is counted once the frame showing it has been drawn.
+  uint16_t reloads = s_diag.reloads;
+  meals_view_render();
+  CHECK(s_diag.render_pending && s_diag.reloads == reloads);
+  shim_render();
+  CHECK(!s_diag.render_pending && s_diag.reloads == reloads + 1);
+  shim_render();
+  CHECK(s_diag.reloads == reloads + 1);
+  // The report fits the outbox even with every counter at its widest.
+  for (int i = 0; i < REQUEST_TYPE_COUNT; i++) {
+    s_diag.requests[i] = (RequestTiming){ 0, 0x80000000, 0x80000000, 0xFFFF };
+  }
+  s_diag.dropped = s_diag.send_failed = s_diag.reloads = 0xFFFF;
+  s_diag.reload_last_ms = s_diag.reload_max_ms = 0x80000000;
+  s_diag.heap_used_max = s_diag.heap_free_min = 0x80000000;
+  while (shim_outbox_in_flight()) {
+    shim_outbox_deliver(true);
+  }
+  diag_window_select_handler(NULL, NULL);
+  const DictionaryIterator *sent = shim_last_sent();
+  Tuple *report = sent ? dict_find(sent, MESSAGE_KEY_DIAG_REPORT) : NULL;
+  CHECK(report != NULL && strncmp(report->value->cstring, "days 65535/", 11) == 0);
+  CHECK(report && strlen(report->value->cstring) < DIAG_REPORT_SIZE);
+  // The window shows the counters on every platform, one per line where its buffer allows.
+  show_diagnostics_window();
+  CHECK(s_diag_text_layer != NULL);
+  CHECK(strncmp(s_diag_text, DIAG_TEXT_SIZE > DIAG_REPORT_SIZE ? "Days: 65535 recv" : "days 65535/", 11) == 0);
+}
+
+// --- Pre-warm ---
+static void test_prewarm_launch(void) {
+  shim_launch_reason = APP_LAUNCH_WAKEUP;
+  app_start();
+  // The window that keeps the app running shows no day list.
+  CHECK(shim_window_count() == 1 && s_menu_layer == NULL);
+  // The phone sends minutes; the "HH:MM" string Clay sends under the same key is ignored.
+  static uint8_t buffer[64];
+  DictionaryIterator iter;
+  shim_dict_begin(&iter, buffer, sizeof(buffer));
+  dict_write_int32(&iter, MESSAGE_KEY_PREWARM_TIME, 7 * 60 + 30);
+  shim_inbox_deliver(&iter);
+  CHECK(persist_read_int(PERSIST_KEY_PREWARM_TIME) == 7 * 60 + 30);
+  shim_dict_begin(&iter, buffer, sizeof(buffer));
+  dict_write_cstring(&iter, MESSAGE_KEY_PREWARM_TIME, "06:45");
+  shim_inbox_deliver(&iter);
+  CHECK(persist_read_int(PERSIST_KEY_PREWARM_TIME) == 7 * 60 + 30);
+  // An error from the phone ends the run.
+  shim_dict_begin(&iter, buffer, sizeof(buffer));
+  dict_write_cstring(&iter, MESSAGE_KEY_ERROR_MSG, "No meals");
+  shim_inbox_deliver(&iter);
+  CHECK(shim_window_count() == 0);
+}
+
+// --- Pages ---
+static void start_paged_list(void) {
+  Payload p;
+  long_meals(&p, 25, MEALS_PAGE_SIZE);
+  s_selected_day = TEST_DAY;
+  handle_meals_data(p.data, p.length, TEST_DAY, TEST_REV);
+}
+
+static void test_page_golden(void) {
+  app_start();
+  start_paged_list();
+  CHECK(s_meal_count == MEALS_PAGE_SIZE && s_meal_total == 25);
+  Payload p;
+  meals_page(&p, TEST_REV, MEALS_PAGE_SIZE, MEALS_PAGE_SIZE);
+  handle_meals_page(p.data, p.length, TEST_DAY);
+  CHECK(s_meals_first == 0 && s_meal_count == 2 * MEALS_PAGE_SIZE);
+  CHECK(s_meal_ids[MEALS_PAGE_SIZE] == 1000 + MEALS_PAGE_SIZE);
+  CHECK(strcmp(s_meal_titles[19], long_meal(19).name) == 0);
+  CHECK(meals_consistent());
+
+  // A page elsewhere in the list replaces the loaded meals, and the page before it is prepended.
+  start_paged_list();
+  meals_page(&p, TEST_REV, 20, 5);
+  handle_meals_page(p.data, p.length, TEST_DAY);
+  CHECK(s_meals_first == 20 && s_meal_count == 5);
+  CHECK(s_meal_ids[0] == 1020);
+  meals_page(&p, TEST_REV, 15, 5);
+  handle_meals_page(p.data, p.length, TEST_DAY);
+  CHECK(s_meals_first == 15 && s_meal_count == 10);
+  CHECK(s_meal_ids[0] == 1015 && s_meal_ids[5] == 1020);
+  CHECK(strcmp(s_meal_titles[9], long_meal(24).name) == 0);
+  CHECK(meals_consistent());
+
+  // A page of an older revision is ignored.
+  meals_page(&p, TEST_REV + 1, 10, 5);
+  handle_meals_page(p.data, p.length, TEST_DAY);
+  CHECK(s_meals_first == 15 && s_meal_count == 10);
+
+  // A page that leaves the selection near the loaded end asks for the next one once the ack
+  // of its transfer has left the outbox.
+  start_paged_list();
+  shim_outbox_deliver(true);
+  shim_menu_select(s_meals_menu_layer, MenuIndex(0, 9));
+  CHECK(reply_value(MESSAGE_KEY_MEALS_PAGE) == 10);
+  shim_outbox_deliver(true);
+  meals_page(&p, TEST_REV, 10, 2);
+  deliver_chunk(5, 0, 0, p.data, p.length, p.length, XFER_KIND_MEALS_PAGE, TEST_DAY, TEST_REV);
+  CHECK(reply_value(MESSAGE_KEY_XFER_ACK) == 1 && s_meal_count == 12);
+  shim_outbox_deliver(true);
+  CHECK(reply_value(MESSAGE_KEY_MEALS_PAGE) == 12 && !s_page_request_pending);
+}
+
+static void test_page_corrupt(void) {
+  app_start();
+  Payload p;
+  meals_page(&p, TEST_REV, MEALS_PAGE_SIZE, MEALS_PAGE_SIZE);
+  for (uint16_t length = 0; length <= p.length; length++) {
+    start_paged_list();
+    uint8_t *data = exact_copy(&p, length);
+    handle_meals_page(data, length, TEST_DAY);
+    CHECK(s_meal_count >= MEALS_PAGE_SIZE && s_meal_count <= 2 * MEALS_PAGE_SIZE);
+    CHECK(meals_consistent());
+    free(data);
+  }
+  CHECK(s_meal_count == 2 * MEALS_PAGE_SIZE);
+}
+
+// --- Name dictionary ---
+static void test_dict_golden(void) {
+  Payload p;
+  golden_dict(&p);
+  handle_dict_data(p.data, p.length);
+  CHECK(s_dict.id == 0xBEEF && s_dict.count == 2);
+  CHECK(strcmp(dict_expand("\xFF\x01 mit \xFF\x02"), "Kartoffel mit Schnitzel") == 0);
+  CHECK(strcmp(dict_expand("Suppe"), "Suppe") == 0);
+  // References the watch does not hold are dropped, as is a reference cut off at the end.
+  CHECK(strcmp(dict_expand("\xFF\x03" "Brot\xFF"), "Brot") == 0);
+  // Persisted and read back at launch.
+  s_dict = (DictHeader){ 0 };
+  dict_load();
+  CHECK(s_dict.id == 0xBEEF && s_dict.count == 2);
+  CHECK(strcmp(dict_expand("\xFF\x02"), "Schnitzel") == 0);
+}
+
+static void test_dict_expand_overflow(void) {
+  Payload p;
+  golden_dict(&p);
+  handle_dict_data(p.data, p.length);
+  // 100 references expand to 900 bytes; the result is cut to the buffer.
+  char name[201];
+  for (int i = 0; i < 100; i++) {
+    name[2 * i] = (char)DICT_REF;
+    name[2 * i + 1] = 1 + i % 2;
+  }
+  name[200] = '\0';
+  const char *expanded = dict_expand(name);
+  CHECK(strlen(expanded) == sizeof(s_title_buffer) - 1);
+  // A multi-byte character is not split at the cut.
+  strcpy(name, "\xFF\x01");
+  for (int i = 2; i + 2 <= 200; i += 2) {
+    memcpy(name + i, "ä", 2);
+  }
+  name[200] = '\0';
+  expanded = dict_expand(name);
+  size_t length = strlen(expanded);
+  CHECK(length < sizeof(s_title_buffer));
+  CHECK(((uint8_t)expanded[length - 1] & 0xC0) == 0x80);
+}
+
+static void test_dict_corrupt(void) {
+  Payload p;
+  golden_dict(&p);
+  for (uint16_t length = 0; length <= p.length; length++) {
+    s_dict = (DictHeader){ 0 };
+    uint8_t *data = exact_copy(&p, length);
+    handle_dict_data(data, length);
+    CHECK(s_dict.count <= 2 && s_dict.used <= DICT_BYTES);
+    CHECK(dict_index());
+    free(data);
+  }
+  CHECK(s_dict.count == 2);
+  // Entries past a gap are not taken.
+  golden_dict(&p);
+  p.data[3] = 5;
+  handle_dict_data(p.data, p.length);
+  CHECK(s_dict.count == 2);
+}
+
+// --- Notes ---
+static void test_notes_golden(void) {
+  Payload p;
+  golden_notes(&p);
+  arena_reset(&s_detail_arena);
+  CHECK(strcmp(expand_notes(p.data, p.length), "mit Farbstoff\nHallo\nWeizen") == 0);
+  CHECK(strcmp(expand_notes(p.data, 0), "") == 0);
+  // Unknown codes are skipped.
+  static const uint8_t unknown[] = { 2, 200, 13 };
+  arena_reset(&s_detail_arena);
+  CHECK(strcmp(expand_notes(unknown, sizeof(unknown)), "Weizen") == 0);
+}
+
+static void test_notes_corrupt(void) {
+  Payload p;
+  golden_notes(&p);
+  for (uint16_t length = 0; length <= p.length; length++) {
+    uint8_t *data = exact_copy(&p, length);
+    arena_reset(&s_detail_arena);
+    const char *text = expand_notes(data, length);
+    CHECK(strlen(text) <= strlen("mit Farbstoff\nHallo\nWeizen"));
+    CHECK(s_detail_arena.used <= s_detail_arena.capacity);
+    free(data);
+  }
+  // More notes than the detail arena holds are cut at a whole note.
+  p.length = 0;
+  put8(&p, 40);
+  for (int i = 0; i < 40; i++) {
+    put8(&p, NOTE_LITERAL);
+    put_string(&p, "Enthält Spuren von Nüssen und Sesam");
+  }
+  arena_reset(&s_detail_arena);
+  const char *text = expand_notes(p.data, p.length);
+  CHECK(s_detail_arena.used <= s_detail_arena.capacity);
+  CHECK(strlen(text) > 0 && text[strlen(text) - 1] == 'm');
+}
+
+// --- Chunked transfer ---
+static void test_xfer_golden(void) {
+  app_start();
+  Payload p;
+  long_meals(&p, 12, 12);
+  s_selected_day = TEST_DAY;
+  uint16_t chunk = p.length / 2 + 1;
+  deliver_chunk(7, 0, 0, p.data, chunk, p.length, XFER_KIND_MEALS, TEST_DAY, TEST_REV);
+  CHECK(reply_value(MESSAGE_KEY_XFER_ID) == 7 && reply_value(MESSAGE_KEY_XFER_ACK) == 1);
+  shim_outbox_deliver(true);
+  // A duplicate is acknowledged again, a gap is answered with the chunk expected next.
+  deliver_chunk(7, 0, 0, p.data, chunk, p.length, XFER_KIND_MEALS, TEST_DAY, TEST_REV);
+  CHECK(reply_value(MESSAGE_KEY_XFER_ACK) == 1);
+  shim_outbox_deliver(true);
+  deliver_chunk(7, 2, 2 * chunk, p.data, 0, p.length, XFER_KIND_MEALS, 0, 0);
+  CHECK(reply_value(MESSAGE_KEY_XFER_NACK) == 1);
+  shim_outbox_deliver(true);
+  deliver_chunk(7, 1, chunk, p.data + chunk, p.length - chunk, p.length, XFER_KIND_MEALS, 0, 0);
+  CHECK(reply_value(MESSAGE_KEY_XFER_ACK) == 2);
+  shim_outbox_deliver(true);
+  CHECK(s_meal_count == 12 && s_meals_rev == TEST_REV);
+  CHECK(s_transfer.buffer == NULL);
+  // Late duplicates of a complete transfer are still acknowledged.
+  deliver_chunk(7, 1, chunk, p.data + chunk, p.length - chunk, p.length, XFER_KIND_MEALS, 0, 0);
+  CHECK(reply_value(MESSAGE_KEY_XFER_ACK) == 2);
+  shim_outbox_deliver(true);
+  // The same id with another size comes from a restarted phone and is a new transfer.
+  golden_meals(&p);
+  deliver_chunk(7, 0, 0, p.data, p.length, p.length, XFER_KIND_MEALS, TEST_DAY, TEST_REV + 1);
+  CHECK(reply_value(MESSAGE_KEY_XFER_ACK) == 1);
+  shim_outbox_deliver(true);
+  CHECK(s_meal_count == GOLDEN_MEALS && s_meals_rev == TEST_REV + 1);
+}
+
+static void test_xfer_rejected(void) {
+  app_start();
+  Payload p;
+  golden_meals(&p);
+  int sent = shim_sent_count;
+  // Chunks of a transfer that never started are ignored.
+  deliver_chunk(3, 1, 10, p.data, 10, p.length, XFER_KIND_MEALS, 0, 0);
+  CHECK(shim_sent_count == sent);
+  // Too large for the platform.
+  deliver_chunk(4, 0, 0, p.data, p.length, XFER_MAX_SIZE + 1, XFER_KIND_MEALS, TEST_DAY, TEST_REV);
+  CHECK(shim_sent_count == sent && s_transfer.buffer == NULL);
+  // Out of memory: not acknowledged, so the phone resends, and the governor steps down.
+  shim_heap.fail_after = 0;
+  deliver_chunk(5, 0, 0, p.data, p.length, p.length, XFER_KIND_MEALS, TEST_DAY, TEST_REV);
+  shim_heap.fail_after = -1;
+  CHECK(s_transfer.buffer == NULL);
+  CHECK(reply_value(MESSAGE_KEY_XFER_ACK) == -1);
+  CHECK(s_mem_level == MEM_LEVEL_NO_ICONS);
+  // A chunk running past the announced total.
+  shim_outbox_deliver(true);
+  deliver_chunk(6, 0, 0, p.data, p.length, p.length - 1, XFER_KIND_MEALS, TEST_DAY, TEST_REV);
+  // The governor stepped back up first; its report holds the outbox until it is sent.
+  CHECK(reply_value(MESSAGE_KEY_MEM_LEVEL) == MEM_LEVEL_NORMAL);
+  shim_outbox_deliver(true);
+  CHECK(reply_value(MESSAGE_KEY_XFER_NACK) == 0);
+}
+
+// --- Fuzzing ---
+typedef void (*FuzzTarget)(const uint8_t *data, uint16_t length);
+
+static void fuzz_meals(const uint8_t *data, uint16_t length) {
+  free_meals();
+  s_meal_count = MAX(parse_meals_data(data, length), 0);
+  classify_meals();
+}
+
+static void fuzz_delta(const uint8_t *data, uint16_t length) {
+  load_golden_meals();
+  bool relayout = false;
+  if (length >= MEALS_DELTA_HEADER_SIZE) {
+    apply_meals_delta(data, length, &relayout);
+  }
+}
+
+static void fuzz_page(const uint8_t *data, uint16_t length) {
+  start_paged_list();
+  handle_meals_page(data, length, TEST_DAY);
+}
+
+static void fuzz_dict(const uint8_t *data, uint16_t length) {
+  if (next_random() % 2) {
+    s_dict = (DictHeader){ 0 };
+  }
+  handle_dict_data(data, length);
+  CHECK(dict_index());
+  static const char name[] = "\xFF\x01 \xFF\x02 \xFF\x03 \xFF\xFF";
+  CHECK(strlen(dict_expand(name)) < sizeof(s_title_buffer));
+}
+
+static void fuzz_notes(const uint8_t *data, uint16_t length) {
+  arena_reset(&s_detail_arena);
+  expand_notes(data, length);
+  CHECK(s_detail_arena.used <= s_detail_arena.capacity);
+}
+
+// Chunks with random header fields around a valid transfer.
+static void fuzz_xfer(const uint8_t *data, uint16_t length) {
+  uint16_t total = next_random() % 2 ? length : next_random() % (XFER_MAX_SIZE + 16);
+  uint8_t seq = next_random() % 3;
+  uint32_t offset = next_random() % 2 ? s_transfer.received : next_random() % (length + 1);
+  uint16_t size = next_random() % (length + 1 - MIN(offset, length));
+  deliver_chunk(1 + next_random() % 3, seq, offset, data + MIN(offset, length), size, total,
+                1 + next_random() % 5, TEST_DAY, TEST_REV);
+  shim_outbox_deliver(true);
+  CHECK(s_transfer.received <= s_transfer.total);
+}
+
+static void fuzz(const char *name, FuzzTarget target, const Payload *golden, int rounds) {
+  for (int round = 0; round < rounds; round++) {
+    Payload p = *golden;
+    uint16_t length = mutate(&p);
+    uint8_t *data = exact_copy(&p, length);
+    target(data, length);
+    free(data);
+    CHECK(meals_consistent());
+    if (s_failures > 0) {
+      fprintf(stderr, "  %s: failed in round %d\n", name, round);
+      return;
+    }
+  }
+}
+
+static int s_fuzz_rounds = 500;
+
+static void test_fuzz(void) {
+  app_start();
+  s_selected_day = TEST_DAY;
+  meals_layout_rows(144);
+  Payload p;
+  golden_meals(&p);
+  fuzz("meals", fuzz_meals, &p, s_fuzz_rounds);
+  golden_delta(&p);
+  fuzz("delta", fuzz_delta, &p, s_fuzz_rounds);
+  meals_page(&p, TEST_REV, MEALS_PAGE_SIZE, MEALS_PAGE_SIZE);
+  fuzz("page", fuzz_page, &p, s_fuzz_rounds);
+  golden_dict(&p);
+  fuzz("dict", fuzz_dict, &p, s_fuzz_rounds);
+  golden_notes(&p);
+  fuzz("notes", fuzz_notes, &p, s_fuzz_rounds);
+  golden_meals(&p);
+  fuzz("xfer", fuzz_xfer, &p, s_fuzz_rounds);
+}
+
+// --- Benchmarks ---
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void bench(const char *name, FuzzTarget target, const Payload *p) {
+  shim_heap_reset_peak();
+  size_t base = shim_heap.used;
+  target(p->data, p->length);
+  size_t peak = shim_heap.peak - base;
+  uint64_t start = now_ns();
+  uint64_t elapsed = 0;
+  int runs = 0;
+  while (elapsed < 200000000) {
+    target(p->data, p->length);
+    runs++;
+    elapsed = now_ns() - start;
+  }
+  printf("  %-28s %5d bytes %9.0f ns/payload %6d bytes peak heap\n", name, (int)p->length,
+         (double)elapsed / runs, (int)peak);
+}
+
+static void bench_parse(const uint8_t *data, uint16_t length) {
+  free_meals();
+  parse_meals_data(data, length);
+}
+
+static void bench_delta(const uint8_t *data, uint16_t length) {
+  load_golden_meals();
+  bool relayout = false;
+  apply_meals_delta(data, length, &relayout);
+}
+
+static uint8_t s_bench_id = 0;
+
+// The whole inbound path: chunks, acks, decoding, caching and the meals window.
+static void bench_xfer(const uint8_t *data, uint16_t length) {
+  Payload p;
+  memcpy(p.data, data, length);
+  p.length = length;
+  s_bench_id = s_bench_id % 250 + 1;
+  deliver_transfer(s_bench_id, XFER_KIND_MEALS, &p, TEST_DAY, TEST_REV);
+}
+
+static void test_bench(void) {
+  app_start();
+  s_selected_day = TEST_DAY;
+  meals_layout_rows(144);
+  Payload p;
+  golden_meals(&p);
+  bench("parse_meals_data golden", bench_parse, &p);
+  long_meals(&p, MAX_MEALS, MAX_MEALS);
+  bench("parse_meals_data full", bench_parse, &p);
+  golden_delta(&p);
+  bench("apply_meals_delta golden", bench_delta, &p);
+  meals_page(&p, TEST_REV, MEALS_PAGE_SIZE, MEALS_PAGE_SIZE);
+  bench("handle_meals_page", fuzz_page, &p);
+  golden_dict(&p);
+  bench("handle_dict_data", fuzz_dict, &p);
+  golden_notes(&p);
+  bench("expand_notes", fuzz_notes, &p);
+  golden_meals(&p);
+  bench("xfer meals golden", bench_xfer, &p);
+  long_meals(&p, MAX_MEALS, MAX_MEALS);
+  if (p.length <= XFER_MAX_SIZE) {
+    bench("xfer meals full", bench_xfer, &p);
+  }
+}
+
+// --- Runner ---
+typedef struct {
+  const char *name;
+  void (*run)(void);
+} Test;
+
+static const Test s_tests[] = {
+  { "parse_meals_golden", test_parse_meals_golden },
+  { "parse_meals_paged", test_parse_meals_paged },
+  { "parse_meals_corrupt", test_parse_meals_corrupt },
+  { "meals_data_message", test_meals_data_message },
+  { "meal_cache_failures", test_meal_cache_failures },
+  { "storage_budget", test_storage_budget },
+  { "meals_unavailable", test_meals_unavailable },
+  { "delta_golden", test_delta_golden },
+  { "delta_short_names", test_delta_short_names },
+  { "delta_corrupt", test_delta_corrupt },
+  { "row_layout", test_row_layout },
+  { "diag_report", test_diag_report },
+  { "prewarm_launch", test_prewarm_launch },
+  { "page_golden", test_page_golden },
+  { "page_corrupt", test_page_corrupt },
+  { "dict_golden", test_dict_golden },
+  { "dict_expand_overflow", test_dict_expand_overflow },
+  { "dict_corrupt", test_dict_corrupt },
+  { "notes_golden", test_notes_golden },
+  { "notes_corrupt", test_notes_corrupt },
+  { "xfer_golden", test_xfer_golden },
+  { "xfer_rejected", test_xfer_rejected },
+  { "fuzz", test_fuzz },
+};
+
+// Runs test in a child process; returns whether it passed.
+static bool run_test(const Test *test) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    test->run();
+    fflush(stdout);
+    _exit(s_failures > 0 ? 1 : 0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  bool passed = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (WIFSIGNALED(status)) {
+    fprintf(stderr, "  killed by signal %d\n", WTERMSIG(status));
+  }
+  printf("%s %s\n", passed ? "PASS" : "FAIL", test->name);
+  return passed;
+}
+
+int main(int argc, char *argv[]) {
+  bool run_bench = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--resources") == 0 && i + 1 < argc) {
+      shim_resource_dir = argv[++i];
+    } else if (strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc) {
+      s_fuzz_rounds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--bench") == 0) {
+      run_bench = true;
+    } else if (strcmp(argv[i], "--verbose") == 0) {
+      shim_verbose = true;
+    }
+  }
+  if (run_bench) {
+    return run_test(&(Test){ "bench", test_bench }) ? 0 : 1;
+  }
+  int failed = 0;
+  for (size_t i = 0; i < sizeof(s_tests) / sizeof(s_tests[0]); i++) {
+    failed += !run_test(&s_tests[i]);
+  }
+  printf("%d of %d tests failed\n", failed, (int)(sizeof(s_tests) / sizeof(s_tests[0])));
+  return failed > 0 ? 1 : 0;
+}
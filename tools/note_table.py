@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""
+Compiles the known OpenMensa note strings in src/pkjs/notes.json into resources/data/note_table.bin,
+the NOTE_TABLE resource read by OpenMensa.c. index.js sends notes as indices into the same list.
+Run it after editing notes.json and commit both files; the build only checks that they match.
+
+    python3 tools/note_table.py           rewrites the resource
+    python3 tools/note_table.py --check   exits with 1 if the resource is out of date
+"""
+import json
+import os
+import struct
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+NOTE_TABLE_SOURCE = 'src/pkjs/notes.json'
+NOTE_TABLE_RESOURCE = 'resources/data/note_table.bin'
+NOTE_LITERAL = 0xFF  # Note code that introduces an inline string; must match OpenMensa.c.
+
+
+def note_table_content(root=ROOT):
+    """
+    Returns the resource: [count:2 LE][offset:2 LE] * (count + 1) then the UTF-8 strings without
+    terminators. Offsets are from the start of the resource; string i spans offset[i] to offset[i + 1].
+    """
+    with open(os.path.join(root, NOTE_TABLE_SOURCE), encoding='utf-8') as f:
+        notes = [note.encode('utf-8') for note in json.load(f)]
+    if len(notes) >= NOTE_LITERAL:
+        raise ValueError('{} holds {} notes, at most {} fit a note code'.format(
+            NOTE_TABLE_SOURCE, len(notes), NOTE_LITERAL - 1))
+    offsets = [2 + 2 * (len(notes) + 1)]
+    for note in notes:
+        offsets.append(offsets[-1] + len(note))
+    return struct.pack('<H', len(notes)) + struct.pack('<{}H'.format(len(offsets)), *offsets) + b''.join(notes)
+
+
+def note_table_current(root=ROOT):
+    """Returns whether the committed resource matches notes.json."""
+    path = os.path.join(root, NOTE_TABLE_RESOURCE)
+    if not os.path.exists(path):
+        return False
+    with open(path, 'rb') as f:
+        return f.read() == note_table_content(root)
+
+
+def main():
+    if sys.argv[1:] == ['--check']:
+        if not note_table_current():
+            sys.exit('{} is out of date; run tools/note_table.py'.format(NOTE_TABLE_RESOURCE))
+        return
+    path = os.path.join(ROOT, NOTE_TABLE_RESOURCE)
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, 'wb') as f:
+        f.write(note_table_content())
+
+
+if __name__ == '__main__':
+    main()